@@ -0,0 +1,34 @@
+#include "base/benchmark.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+uint64_t g_allocations = 0;
+
+}  // namespace
+
+namespace base {
+
+uint64_t BenchmarkAllocationCount() {
+  return g_allocations;
+}
+
+}  // namespace base
+
+// Counts every allocation the benchmarks make.
+void* operator new(size_t size) {
+  g_allocations++;
+  if (void* result = malloc(size ? size : 1))
+    return result;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+  free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+  free(pointer);
+}
@@ -0,0 +1,52 @@
+#ifndef BASE_BENCHMARK_H_
+#define BASE_BENCHMARK_H_
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+// A minimal harness for the *_benchmark binaries. Link //base:benchmark,
+// which replaces operator new to count allocations.
+
+namespace base {
+
+constexpr int kBenchmarkIterations = 2000000;
+constexpr int kBenchmarkRounds = 5;
+
+// Keeps the compiler from discarding the computation of |value|.
+template <typename T>
+void DoNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// The number of operator new calls made so far in the process.
+uint64_t BenchmarkAllocationCount();
+
+// Calls |function(i)| kBenchmarkIterations times per round and prints the
+// time and heap allocations per call of the fastest of kBenchmarkRounds
+// rounds, which is the one least disturbed by the rest of the machine.
+template <typename Function>
+void RunBenchmark(const char* name, Function function) {
+  for (int i = 0; i < 1000; i++)
+    function(i);
+  double best_nanos = 0;
+  uint64_t allocations = 0;
+  for (int round = 0; round < kBenchmarkRounds; round++) {
+    uint64_t start_allocations = BenchmarkAllocationCount();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kBenchmarkIterations; i++)
+      function(i);
+    std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (!round || elapsed.count() < best_nanos)
+      best_nanos = elapsed.count();
+    allocations = BenchmarkAllocationCount() - start_allocations;
+  }
+  printf("%-32s %8.2f ns/op %6.2f allocations/op\n", name,
+         best_nanos / kBenchmarkIterations,
+         static_cast<double>(allocations) / kBenchmarkIterations);
+}
+
+}  // namespace base
+
+#endif  // BASE_BENCHMARK_H_
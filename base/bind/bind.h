@@ -4,7 +4,9 @@
 
 #include <stddef.h>
 #include <memory>
+#include <new>
 #include <tuple>
+#include <type_traits>
 #include <utility>
 
 #include "base/location.h"
@@ -94,98 +96,190 @@ struct MakeFunctorTraits<Return (*)(Args...)> {
   using ReturnType = Return;
 };
 
-template <size_t...>
-struct ArgSeq {};
-
-template <size_t N, size_t... S>
-struct GenSeq : GenSeq<N - 1, N - 1, S...> {};
-
-template <size_t... S>
-struct GenSeq<0, S...> {
-  typedef ArgSeq<S...> type;
-};
-
-template <typename R, typename T>
-struct Expander;
+// Holds a functor and its bound arguments for a RepeatingCallback, which may
+// run it any number of times. The bound arguments are constructed in place
+// and copied straight into each call.
+template <typename Return, typename BoundTuple, typename... Needed>
+class Invoker {
+ public:
+  template <typename... Bound>
+  explicit Invoker(void* functor, Bound&&... bound)
+      : functor_(functor), bound_(std::forward<Bound>(bound)...) {}
 
-template <typename R, typename... Args>
-struct Expander<R, std::tuple<Args...>> {
-  static R Expand(void* functor, std::tuple<Args...> args) {
-    return ExpandInternal(reinterpret_cast<R (*)(Args...)>(functor),
-                          std::move(args),
-                          typename GenSeq<sizeof...(Args)>::type());
+  Return Invoke(Needed&&... args) {
+    return Call(std::make_index_sequence<std::tuple_size_v<BoundTuple>>(),
+                std::forward<Needed>(args)...);
   }
 
-  template <size_t... S>
-  static R ExpandInternal(R (*method)(Args...),
-                          std::tuple<Args...> args,
-                          ArgSeq<S...>) {
-    return method(std::move(std::get<S>(args))...);
-  }
-};
+ private:
+  void* functor_;
+  BoundTuple bound_;
 
-template <typename Return, typename... Needed>
-class InvokerBase {
- public:
-  virtual Return Invoke(Needed&&... args) = 0;
-  virtual std::unique_ptr<InvokerBase> Copy() = 0;
+  template <size_t... I>
+  Return Call(std::index_sequence<I...>, Needed&&... args) {
+    auto function = reinterpret_cast<Return (*)(
+        std::tuple_element_t<I, BoundTuple>..., Needed...)>(functor_);
+    return function(std::get<I>(bound_)..., std::forward<Needed>(args)...);
+  }
 };
 
+// As Invoker, for a OnceCallback: the bound arguments are moved straight into
+// the call.
 template <typename Return, typename BoundTuple, typename... Needed>
-class Invoker : public InvokerBase<Return, Needed...> {
+class InvokerOnce {
  public:
-  Invoker(void* functor, BoundTuple bound) {
-    functor_ = functor;
-    bound_ = bound;
-  }
+  template <typename... Bound>
+  explicit InvokerOnce(void* functor, Bound&&... bound)
+      : functor_(functor), bound_(std::forward<Bound>(bound)...) {}
 
   Return Invoke(Needed&&... args) {
-    auto new_args = std::make_tuple(std::forward<Needed>(args)...);
-    auto all_args = std::tuple_cat(bound_, std::move(new_args));
-    return InvokeInternal(std::move(all_args));
-  }
-
-  std::unique_ptr<InvokerBase<Return, Needed...>> Copy() {
-    return std::make_unique<Invoker<Return, BoundTuple, Needed...>>(functor_,
-                                                                    bound_);
+    return Call(std::make_index_sequence<std::tuple_size_v<BoundTuple>>(),
+                std::forward<Needed>(args)...);
   }
 
  private:
   void* functor_;
   BoundTuple bound_;
 
-  template <typename... All>
-  Return InvokeInternal(std::tuple<All...> arguments) {
-    return Expander<Return, std::tuple<All...>>::Expand(functor_,
-                                                        std::move(arguments));
+  template <size_t... I>
+  Return Call(std::index_sequence<I...>, Needed&&... args) {
+    auto function = reinterpret_cast<Return (*)(
+        std::tuple_element_t<I, BoundTuple>..., Needed...)>(functor_);
+    return function(std::move(std::get<I>(bound_))...,
+                    std::forward<Needed>(args)...);
   }
 };
 
-template <typename Return, typename BoundTuple, typename... Needed>
-class InvokerOnce : public InvokerBase<Return, Needed...> {
+// A type-erased Invoker or InvokerOnce. One that fits in kInlineSize bytes is
+// stored inside the callback, so binding a function pointer and a few small
+// arguments doesn't allocate; larger ones go to the heap. Calls go through a
+// plain function pointer rather than a vtable.
+template <typename Return, typename... Needed>
+class CallbackStorage {
  public:
-  InvokerOnce(void* functor, BoundTuple bound) {
-    functor_ = functor;
-    bound_ = std::move(bound);
+  static constexpr size_t kInlineSize = 3 * sizeof(void*);
+
+  CallbackStorage() = default;
+
+  // Constructs an |InvokerT| from |args| in place.
+  template <typename InvokerT, typename... Args>
+  explicit CallbackStorage(std::in_place_type_t<InvokerT>, Args&&... args)
+      : invoke_(&InvokeImpl<InvokerT>), manage_(&Manage<InvokerT>) {
+    if constexpr (kFitsInline<InvokerT>)
+      new (inline_) InvokerT(std::forward<Args>(args)...);
+    else
+      heap_ = new InvokerT(std::forward<Args>(args)...);
   }
 
-  Return Invoke(Needed&&... args) {
-    auto new_args = std::make_tuple(std::forward<Needed>(args)...);
-    auto all_args = std::tuple_cat(std::move(bound_), std::move(new_args));
-    return InvokeInternal(std::move(all_args));
+  // Only RepeatingCallbacks, whose invokers are copyable, copy their storage.
+  CallbackStorage(const CallbackStorage& other)
+      : invoke_(other.invoke_), manage_(other.manage_) {
+    if (manage_)
+      manage_(kCopy, const_cast<CallbackStorage*>(&other), this);
   }
 
-  std::unique_ptr<InvokerBase<Return, Needed...>> Copy() { return nullptr; }
+  CallbackStorage(CallbackStorage&& other) noexcept
+      : invoke_(other.invoke_), manage_(other.manage_) {
+    if (manage_)
+      manage_(kMove, &other, this);
+    other.invoke_ = nullptr;
+    other.manage_ = nullptr;
+  }
+
+  CallbackStorage& operator=(const CallbackStorage& other) {
+    if (this != &other)
+      *this = CallbackStorage(other);
+    return *this;
+  }
+
+  CallbackStorage& operator=(CallbackStorage&& other) noexcept {
+    if (this == &other)
+      return *this;
+    Reset();
+    invoke_ = std::exchange(other.invoke_, nullptr);
+    manage_ = std::exchange(other.manage_, nullptr);
+    if (manage_)
+      manage_(kMove, &other, this);
+    return *this;
+  }
+
+  ~CallbackStorage() { Reset(); }
+
+  explicit operator bool() const { return invoke_; }
+
+  Return Invoke(Needed&&... args) {
+    return invoke_(this, std::forward<Needed>(args)...);
+  }
 
  private:
-  void* functor_;
-  BoundTuple bound_;
+  enum Operation { kCopy, kMove, kDestroy };
+
+  using InvokeFunction = Return (*)(CallbackStorage*, Needed&&...);
+  using ManageFunction = void (*)(Operation,
+                                  CallbackStorage* from,
+                                  CallbackStorage* to);
+
+  template <typename T>
+  static constexpr bool kFitsInline =
+      sizeof(T) <= kInlineSize && alignof(T) <= alignof(void*) &&
+      std::is_nothrow_move_constructible<T>::value;
+
+  template <typename T>
+  static T* Get(CallbackStorage* storage) {
+    if constexpr (kFitsInline<T>)
+      return std::launder(reinterpret_cast<T*>(storage->inline_));
+    else
+      return static_cast<T*>(storage->heap_);
+  }
 
-  template <typename... All>
-  Return InvokeInternal(std::tuple<All...> arguments) {
-    return Expander<Return, std::tuple<All...>>::Expand(functor_,
-                                                        std::move(arguments));
+  template <typename T>
+  static Return InvokeImpl(CallbackStorage* storage, Needed&&... args) {
+    return Get<T>(storage)->Invoke(std::forward<Needed>(args)...);
   }
+
+  template <typename T>
+  static void Manage(Operation operation,
+                     CallbackStorage* from,
+                     CallbackStorage* to) {
+    switch (operation) {
+      case kCopy:
+        if constexpr (!std::is_copy_constructible<T>::value)
+          break;
+        else if constexpr (kFitsInline<T>)
+          new (to->inline_) T(*Get<T>(from));
+        else
+          to->heap_ = new T(*Get<T>(from));
+        break;
+      case kMove:
+        if constexpr (kFitsInline<T>) {
+          new (to->inline_) T(std::move(*Get<T>(from)));
+          Get<T>(from)->~T();
+        } else {
+          to->heap_ = from->heap_;
+        }
+        break;
+      case kDestroy:
+        if constexpr (kFitsInline<T>)
+          Get<T>(from)->~T();
+        else
+          delete Get<T>(from);
+        break;
+    }
+  }
+
+  void Reset() {
+    if (manage_)
+      manage_(kDestroy, this, nullptr);
+    invoke_ = nullptr;
+    manage_ = nullptr;
+  }
+
+  union {
+    alignas(void*) char inline_[kInlineSize];
+    void* heap_;
+  };
+  InvokeFunction invoke_ = nullptr;
+  ManageFunction manage_ = nullptr;
 };
 
 template <typename R, typename T, typename List>
@@ -265,22 +359,20 @@ struct CallbackDefaultConstruct<void> {
 template <typename R, typename... Args>
 class RepeatingCallback<R(Args...)> {
  private:
-  std::unique_ptr<InvokerBase<R, Args...>> invoker_;
+  CallbackStorage<R, Args...> invoker_;
   Location bound_at_;
 
  public:
-  RepeatingCallback(std::unique_ptr<InvokerBase<R, Args...>> invoker,
-                    Location bound_at)
-      : invoker_(std::move(invoker)), bound_at_(bound_at) {}
-
-  RepeatingCallback() : bound_at_(Location::Current()) { invoker_ = nullptr; }
+  template <typename InvokerT, typename... InvokerArgs>
+  RepeatingCallback(Location bound_at,
+                    std::in_place_type_t<InvokerT> type,
+                    InvokerArgs&&... args)
+      : invoker_(type, std::forward<InvokerArgs>(args)...),
+        bound_at_(bound_at) {}
 
-  RepeatingCallback(const RepeatingCallback& from) {
-    bound_at_ = from.GetSource();
-    invoker_ = from.invoker_->Copy();
-  }
+  RepeatingCallback() : bound_at_(Location::Current()) {}
 
-  R Run(Args... args) { return invoker_->Invoke(std::forward<Args>(args)...); }
+  R Run(Args... args) { return invoker_.Invoke(std::forward<Args>(args)...); }
 
   Location GetSource() const { return bound_at_; }
 };
@@ -288,18 +380,24 @@ class RepeatingCallback<R(Args...)> {
 template <typename R, typename... Args>
 class OnceCallback<R(Args...)> {
  private:
-  std::unique_ptr<InvokerBase<R, Args...>> invoker_;
+  CallbackStorage<R, Args...> invoker_;
   Location bound_at_;
 
  public:
-  OnceCallback(std::unique_ptr<InvokerBase<R, Args...>> invoker,
-               Location bound_at)
-      : invoker_(std::move(invoker)), bound_at_(bound_at) {}
+  template <typename InvokerT, typename... InvokerArgs>
+  OnceCallback(Location bound_at,
+               std::in_place_type_t<InvokerT> type,
+               InvokerArgs&&... args)
+      : invoker_(type, std::forward<InvokerArgs>(args)...),
+        bound_at_(bound_at) {}
 
-  OnceCallback() : bound_at_(Location::Current()) { invoker_ = nullptr; }
+  OnceCallback() : bound_at_(Location::Current()) {}
+
+  OnceCallback(OnceCallback&&) = default;
+  OnceCallback& operator=(OnceCallback&&) = default;
 
   R Run(Args... args) && {
-    return invoker_->Invoke(std::forward<Args>(args)...);
+    return invoker_.Invoke(std::forward<Args>(args)...);
   }
 
   Location GetSource() const { return bound_at_; }
@@ -310,22 +408,18 @@ inline RepeatingCallback<UnboundRunType<Functor, Bound...>> BindRepeating(
     Functor&& functor,
     Bound&&... args) {
   // TODO replace Invoker<ReturnType<Functor>> with a handler for binding binds.
-  auto invoker = std::make_unique<InvokerType<Functor, Bound...>>(
-      reinterpret_cast<void*>(functor),
-      std::make_tuple(std::forward<Bound>(args)...));
-
   return RepeatingCallback<UnboundRunType<Functor, Bound...>>(
-      std::move(invoker), Location::Current());
+      Location::Current(), std::in_place_type<InvokerType<Functor, Bound...>>,
+      reinterpret_cast<void*>(functor), std::forward<Bound>(args)...);
 }
 
 template <typename Functor>
 inline RepeatingCallback<UnboundRunType<Functor>> BindRepeating(
     Functor&& functor,
     Location loc = Location::Current()) {
-  auto invoker = std::make_unique<InvokerType<Functor>>(
-      reinterpret_cast<void*>(functor), std::make_tuple());
-
-  return RepeatingCallback<UnboundRunType<Functor>>(std::move(invoker), loc);
+  return RepeatingCallback<UnboundRunType<Functor>>(
+      loc, std::in_place_type<InvokerType<Functor>>,
+      reinterpret_cast<void*>(functor));
 }
 
 template <typename Functor, typename... Bound>
@@ -333,22 +427,19 @@ inline OnceCallback<UnboundRunType<Functor, Bound...>> BindOnce(
     Functor&& functor,
     Bound&&... args) {
   // TODO replace Invoker<ReturnType<Functor>> with a handler for binding binds.
-  auto invoker = std::make_unique<InvokerOnceType<Functor, Bound...>>(
-      reinterpret_cast<void*>(functor),
-      std::make_tuple(std::forward<Bound>(args)...));
-
-  return OnceCallback<UnboundRunType<Functor, Bound...>>(std::move(invoker),
-                                                         Location::Current());
+  return OnceCallback<UnboundRunType<Functor, Bound...>>(
+      Location::Current(),
+      std::in_place_type<InvokerOnceType<Functor, Bound...>>,
+      reinterpret_cast<void*>(functor), std::forward<Bound>(args)...);
 }
 
 template <typename Functor>
 inline OnceCallback<UnboundRunType<Functor>> BindOnce(
     Functor&& functor,
     Location loc = Location::Current()) {
-  auto invoker = std::make_unique<InvokerOnceType<Functor>>(
-      reinterpret_cast<void*>(functor), std::make_tuple());
-
-  return OnceCallback<UnboundRunType<Functor>>(std::move(invoker), loc);
+  return OnceCallback<UnboundRunType<Functor>>(
+      loc, std::in_place_type<InvokerOnceType<Functor>>,
+      reinterpret_cast<void*>(functor));
 }
 
 template <typename S, typename P = typename MakeFunctorTraits<S>::ClassType>
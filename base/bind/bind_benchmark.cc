@@ -0,0 +1,60 @@
+// Measures what binding a callback and running it costs, in time and heap
+// allocations per operation, next to the same work done with std::function.
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <utility>
+
+#include "base/benchmark.h"
+#include "base/bind/bind.h"
+
+namespace {
+
+__attribute__((noinline)) int Add(int a, int b, int c) {
+  return a + b + c;
+}
+
+__attribute__((noinline)) int AddLengths(std::string a,
+                                         std::string b,
+                                         int c,
+                                         int d,
+                                         int e) {
+  return static_cast<int>(a.size() + b.size()) + c + d + e;
+}
+
+}  // namespace
+
+int main() {
+  printf("sizeof(OnceCallback<int(int)>) %zu, sizeof(std::function) %zu\n",
+         sizeof(base::OnceCallback<int(int)>), sizeof(std::function<int(int)>));
+  const std::string kLong(40, 'x');
+
+  base::RunBenchmark("BindOnce, 2 ints, Run", [](int i) {
+    base::DoNotOptimize(base::BindOnce(&Add, i, 2).Run(3));
+  });
+  base::RunBenchmark("BindRepeating, 2 ints, Run", [](int i) {
+    auto callback = base::BindRepeating(&Add, i, 2);
+    base::DoNotOptimize(callback.Run(3));
+  });
+  base::RunBenchmark("std::function, 2 ints, call", [](int i) {
+    std::function<int(int)> function = [i](int c) { return Add(i, 2, c); };
+    base::DoNotOptimize(function(3));
+  });
+  base::RunBenchmark("BindRepeating, copy and Run", [](int i) {
+    static auto callback = base::BindRepeating(&Add, 1, 2);
+    auto copy = callback;
+    base::DoNotOptimize(copy.Run(i));
+  });
+  base::RunBenchmark("BindOnce, 2 strings 2 ints, Run", [&kLong](int i) {
+    base::DoNotOptimize(base::BindOnce(&AddLengths, kLong, kLong, i, 2).Run(3));
+  });
+  base::RunBenchmark("std::function, 2 strings 2 ints", [&kLong](int i) {
+    std::function<int(int)> function = [kLong, i](int e) {
+      return AddLengths(kLong, kLong, i, 2, e);
+    };
+    base::DoNotOptimize(function(3));
+  });
+  return 0;
+}
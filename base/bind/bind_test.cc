@@ -0,0 +1,208 @@
+#include "base/bind/bind.h"
+
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+int g_allocations = 0;
+
+}  // namespace
+
+// Counts allocations, to tell callbacks stored inline from those on the heap.
+void* operator new(size_t size) {
+  g_allocations++;
+  if (void* result = malloc(size ? size : 1))
+    return result;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+  free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+  free(pointer);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+
+namespace base {
+namespace {
+
+// Counts its copies and moves.
+struct Probe {
+  static inline int copies = 0;
+  static inline int moves = 0;
+
+  static void Reset() { copies = moves = 0; }
+
+  explicit Probe(int value) : value(value) {}
+  Probe(const Probe& other) : value(other.value) { copies++; }
+  Probe(Probe&& other) noexcept : value(other.value) { moves++; }
+
+  int value;
+};
+
+// Larger than CallbackStorage::kInlineSize once bound.
+struct Large {
+  char bytes[64];
+};
+
+int Add(int a, int b, int c) {
+  return a + b + c;
+}
+
+int AddLarge(Large large, int a) {
+  return large.bytes[0] + a;
+}
+
+int ProbeValue(Probe probe, int a) {
+  return probe.value + a;
+}
+
+int Unbox(std::unique_ptr<int> box, int a) {
+  return *box + a;
+}
+
+std::string Join(std::string a, std::string b) {
+  return a + b;
+}
+
+class Counter {
+ public:
+  int Increment(int by) { return count_ += by; }
+
+ private:
+  int count_ = 0;
+};
+
+TEST(BindTest, BindsLeadingArguments) {
+  EXPECT_EQ(BindOnce(&Add, 1, 2).Run(3), 6);
+  EXPECT_EQ(BindOnce(&Add).Run(1, 2, 3), 6);
+  auto callback = BindRepeating(&Add, 1);
+  EXPECT_EQ(callback.Run(2, 3), 6);
+  EXPECT_EQ(callback.Run(10, 20), 31);
+}
+
+TEST(BindTest, BindsMethods) {
+  Counter counter;
+  RepeatingCallback<int(int)> increment =
+      BindRepeating(&Counter::Increment, &counter);
+  EXPECT_EQ(increment.Run(2), 2);
+  EXPECT_EQ(increment.Run(3), 5);
+  EXPECT_EQ(counter.Increment(0), 5);
+}
+
+TEST(BindTest, RecordsWhereItWasBound) {
+  int line = __LINE__ + 1;
+  auto callback = BindOnce(&Add);
+  EXPECT_EQ(callback.GetSource().line_number(), line);
+}
+
+TEST(BindTest, SmallCallbacksAreStoredInline) {
+  // The first bind interns where it was made.
+  BindRepeating(&Add, 1, 2);
+  int before = g_allocations;
+  auto callback = BindRepeating(&Add, 1, 2);
+  auto copy = callback;
+  auto moved = std::move(copy);
+  int result = moved.Run(3) + callback.Run(3);
+  int allocations = g_allocations - before;
+  EXPECT_EQ(result, 12);
+  EXPECT_EQ(allocations, 0);
+}
+
+TEST(BindTest, LargeCallbacksGoToTheHeap) {
+  Large large = {{5}};
+  BindRepeating(&AddLarge, large);
+  int before = g_allocations;
+  auto callback = BindRepeating(&AddLarge, large);
+  int bound = g_allocations - before;
+  auto copy = callback;
+  int copied = g_allocations - before;
+  auto moved = std::move(copy);
+  int result = moved.Run(1) + callback.Run(2);
+  int allocations = g_allocations - before;
+  EXPECT_EQ(result, 13);
+  EXPECT_EQ(bound, 1);
+  EXPECT_EQ(copied, 2);
+  // Moving hands over the heap allocation.
+  EXPECT_EQ(allocations, 2);
+}
+
+TEST(BindTest, BoundRvaluesAreMovedOnce) {
+  Probe::Reset();
+  auto callback = BindOnce(&ProbeValue, Probe(4));
+  EXPECT_EQ(Probe::copies, 0);
+  EXPECT_EQ(Probe::moves, 1);
+}
+
+TEST(BindTest, BoundLvaluesAreCopiedOnce) {
+  Probe probe(4);
+  Probe::Reset();
+  auto callback = BindOnce(&ProbeValue, probe);
+  EXPECT_EQ(Probe::copies, 1);
+  EXPECT_EQ(Probe::moves, 0);
+}
+
+TEST(BindTest, OnceCallbacksMoveBoundArgumentsIntoTheCall) {
+  auto callback = BindOnce(&ProbeValue, Probe(4));
+  Probe::Reset();
+  EXPECT_EQ(std::move(callback).Run(1), 5);
+  EXPECT_EQ(Probe::copies, 0);
+  EXPECT_EQ(Probe::moves, 1);
+}
+
+TEST(BindTest, RepeatingCallbacksCopyBoundArgumentsIntoEachCall) {
+  auto callback = BindRepeating(&ProbeValue, Probe(4));
+  Probe::Reset();
+  EXPECT_EQ(callback.Run(1), 5);
+  EXPECT_EQ(callback.Run(2), 6);
+  EXPECT_EQ(Probe::copies, 2);
+  EXPECT_EQ(Probe::moves, 0);
+}
+
+TEST(BindTest, OnceCallbacksTakeMoveOnlyArguments) {
+  auto callback = BindOnce(&Unbox, std::make_unique<int>(7));
+  OnceCallback<int(int)> moved = std::move(callback);
+  EXPECT_EQ(std::move(moved).Run(1), 8);
+
+  auto unbound = BindOnce(&Unbox);
+  EXPECT_EQ(std::move(unbound).Run(std::make_unique<int>(2), 3), 5);
+}
+
+TEST(BindTest, CopiesRunIndependently) {
+  const std::string kLong(40, 'x');
+  auto callback = BindRepeating(&Join, kLong);
+  auto copy = callback;
+  callback = BindRepeating(&Join, std::string("a"));
+  EXPECT_EQ(copy.Run("y"), kLong + "y");
+  EXPECT_EQ(callback.Run("b"), "ab");
+}
+
+TEST(BindTest, AssignmentReplacesEitherStorage) {
+  Large large = {{1}};
+  RepeatingCallback<int(int)> on_heap = BindRepeating(&AddLarge, large);
+  RepeatingCallback<int(int)> in_place = BindRepeating(&Add, 1, 2);
+  RepeatingCallback<int(int)> copy = in_place;
+  in_place = on_heap;
+  EXPECT_EQ(in_place.Run(1), 2);
+  on_heap = std::move(copy);
+  EXPECT_EQ(on_heap.Run(1), 4);
+
+  OnceCallback<int(int)> once = BindOnce(&AddLarge, large);
+  once = BindOnce(&Add, 3, 4);
+  EXPECT_EQ(std::move(once).Run(5), 12);
+}
+
+}  // namespace
+}  // namespace base
@@ -2,59 +2,108 @@
 #define BASE_CHECK_H_
 
 #include <stdlib.h>
+#include <atomic>
+#include <cstdarg>
 #include <cstdio>
 
-#include <execinfo.h>
+namespace base {
 
-static inline void printBacktrace() {
-  void* stackBuffer[64];
-  int numAddresses = backtrace((void**)&stackBuffer, 64);
-  char** addresses = backtrace_symbols(stackBuffer, numAddresses);
-  for (int i = 0; i < numAddresses; ++i) {
-    fprintf(stderr, "[%2d]: %s\n", i, addresses[i]);
-  }
-  free(addresses);
+// Runs on every CHECK or MCHECK failure, before the process aborts. Used to
+// snapshot diagnostics such as trace buffers.
+using CheckFailureHook = void (*)();
+
+namespace internal {
+inline std::atomic<CheckFailureHook> check_failure_hook = nullptr;
+}  // namespace internal
+
+inline void SetCheckFailureHook(CheckFailureHook hook) {
+  internal::check_failure_hook.store(hook);
+}
+
+inline void RunCheckFailureHook() {
+  if (CheckFailureHook hook = internal::check_failure_hook.load())
+    hook();
+}
+
+namespace internal {
+
+// Where every failed check ends up. Out of line and cold, so that a check
+// costs its call site no more than a compare and a branch that's predicted
+// not taken.
+[[noreturn]] inline __attribute__((cold, noinline)) void CheckFailed(
+    const char* file,
+    int line,
+    const char* condition) {
+  fprintf(stderr, "%s:%i\n", file, line);
+  fprintf(stderr, "Error: %s\n", condition);
+  RunCheckFailureHook();
+  abort();
+}
+
+[[noreturn]] inline __attribute__((cold, noinline, format(printf, 3, 4))) void
+CheckFailedWithMessage(const char* file, int line, const char* format, ...) {
+  fprintf(stderr, "%s:%i\n", file, line);
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+  RunCheckFailureHook();
+  abort();
 }
 
-#define CHECK(cond)                                   \
-  do {                                                \
-    if (!(cond)) {                                    \
-      fprintf(stderr, "%s:%i\n", __FILE__, __LINE__); \
-      fprintf(stderr, "Error: " #cond "\n");          \
-    }                                                 \
+}  // namespace internal
+
+}  // namespace base
+
+// Aborts if |cond| is false, after running the CheckFailureHook. With
+// base::InstallCrashHandler(), the abort prints a stack trace.
+#define CHECK(cond)                                                \
+  do {                                                             \
+    if (__builtin_expect(!(cond), 0))                              \
+      ::base::internal::CheckFailed(__FILE__, __LINE__, #cond);    \
   } while (0)
 
 #define CHECK_EQ(A, B) CHECK((A) == (B))
 
 #define CHECK_NE(A, B) CHECK((A) != (B))
 
-#define MCHECK(cond, ...)  \
-  do {                     \
-    if (!(cond)) {         \
-      printf(__VA_ARGS__); \
-      puts("");            \
-      exit(1);             \
-    }                      \
+// CHECK with a printf-style message.
+#define MCHECK(cond, ...)                                          \
+  do {                                                             \
+    if (__builtin_expect(!(cond), 0)) {                            \
+      ::base::internal::CheckFailedWithMessage(__FILE__, __LINE__, \
+                                               __VA_ARGS__);       \
+    }                                                              \
   } while (0)
 
-#define MCHECK_EQ(A, B, ...) \
-  do {                       \
-    if ((A) != (B)) {        \
-      printf(__VA_ARGS__);   \
-      puts("");              \
-      exit(1);               \
-    }                        \
-  } while (0)
+#define MCHECK_EQ(A, B, ...) MCHECK((A) == (B), __VA_ARGS__)
 
-#define MCHECK_NE(A, B, ...) \
-  do {                       \
-    if ((A) == (B)) {        \
-      printf(__VA_ARGS__);   \
-      puts("");              \
-      exit(1);               \
-    }                        \
-  } while (0)
+#define MCHECK_NE(A, B, ...) MCHECK((A) != (B), __VA_ARGS__)
 
 #define NOTREACHED() MCHECK(false, "Unreached code point")
 
+// DCHECKs are CHECKs in debug builds, and in release builds compile to
+// nothing, though their conditions are still type-checked. Define
+// DCHECK_ALWAYS_ON to keep them in a release build.
+#if !defined(NDEBUG) || defined(DCHECK_ALWAYS_ON)
+#define DCHECK_IS_ON() 1
+#else
+#define DCHECK_IS_ON() 0
+#endif
+
+#if DCHECK_IS_ON()
+#define DCHECK(cond) CHECK(cond)
+#else
+#define DCHECK(cond) \
+  do {               \
+    if (false)       \
+      CHECK(cond);   \
+  } while (0)
+#endif
+
+#define DCHECK_EQ(A, B) DCHECK((A) == (B))
+
+#define DCHECK_NE(A, B) DCHECK((A) != (B))
+
 #endif  // BASE_CHECK_H_
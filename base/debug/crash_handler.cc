@@ -0,0 +1,210 @@
+#include "base/debug/crash_handler.h"
+
+#include <execinfo.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+
+#include "base/debug/signal_safe_writer.h"
+
+namespace base {
+
+namespace {
+
+constexpr int kFatalSignals[] = {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT};
+struct sigaction g_previous_actions[std::size(kFatalSignals)];
+
+std::atomic<bool> g_installed = false;
+std::atomic<bool> g_crashing = false;
+
+std::atomic<CrashCallback> g_callbacks[kMaxCrashCallbacks] = {};
+std::atomic<int> g_callback_count = 0;
+
+char g_alternate_stack[64 * 1024];
+
+// /proc/self/maps as read at the time of the crash. Static, since the heap
+// may be what's broken.
+char g_maps[256 * 1024];
+
+constexpr int kMaxFrames = 64;
+
+// strsignal() may allocate.
+const char* SignalName(int signal) {
+  switch (signal) {
+    case SIGSEGV:
+      return "SIGSEGV";
+    case SIGBUS:
+      return "SIGBUS";
+    case SIGILL:
+      return "SIGILL";
+    case SIGFPE:
+      return "SIGFPE";
+    case SIGABRT:
+      return "SIGABRT";
+    default:
+      return "?";
+  }
+}
+
+// Parses a hex number at |*cursor|, leaving |*cursor| after it.
+uint64_t ParseHex(const char** cursor, const char* end) {
+  uint64_t value = 0;
+  for (; *cursor < end; (*cursor)++) {
+    char c = **cursor;
+    if (c >= '0' && c <= '9')
+      value = value * 16 + (c - '0');
+    else if (c >= 'a' && c <= 'f')
+      value = value * 16 + (c - 'a' + 10);
+    else
+      break;
+  }
+  return value;
+}
+
+size_t ReadMaps() {
+  int fd = open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return 0;
+  size_t size = 0;
+  while (size < sizeof(g_maps)) {
+    ssize_t result = read(fd, g_maps + size, sizeof(g_maps) - size);
+    if (result < 0 && errno == EINTR)
+      continue;
+    if (result <= 0)
+      break;
+    size += result;
+  }
+  close(fd);
+  return size;
+}
+
+// Writes "<path>+<offset>" for the mapping containing |address|, using the
+// "start-end perms offset dev inode path" lines of /proc/self/maps.
+void AppendModuleOffset(SignalSafeWriter& out,
+                        uintptr_t address,
+                        size_t maps_size) {
+  const char* end = g_maps + maps_size;
+  for (const char* line = g_maps; line < end;) {
+    const char* line_end =
+        static_cast<const char*>(memchr(line, '\n', end - line));
+    if (!line_end)
+      line_end = end;
+    const char* cursor = line;
+    uint64_t start = ParseHex(&cursor, line_end);
+    cursor++;
+    uint64_t stop = ParseHex(&cursor, line_end);
+    if (address >= start && address < stop) {
+      // Skip the permissions to reach the file offset.
+      while (cursor < line_end && *cursor != ' ')
+        cursor++;
+      while (cursor < line_end && *cursor == ' ')
+        cursor++;
+      while (cursor < line_end && *cursor != ' ')
+        cursor++;
+      cursor++;
+      uint64_t offset = ParseHex(&cursor, line_end);
+      // The path, if any, is the last field.
+      const char* path = static_cast<const char*>(
+          memchr(cursor, '/', line_end - cursor));
+      out.Append(path ? path : "?", path ? line_end - path : 1);
+      out.Append("+0x");
+      out.AppendHex(address - start + offset);
+      return;
+    }
+    line = line_end + 1;
+  }
+  out.Append("?");
+}
+
+void OnFatalSignal(int signal, siginfo_t* info, void*) {
+  int saved_errno = errno;
+  if (!g_crashing.exchange(true)) {
+    {
+      SignalSafeWriter out(STDERR_FILENO);
+      out.Append("*** Caught signal ");
+      out.AppendUnsigned(signal);
+      out.Append(" (");
+      out.Append(SignalName(signal));
+      out.Append(") at address 0x");
+      out.AppendHex(reinterpret_cast<uintptr_t>(info->si_addr));
+      out.Append(", pid ");
+      out.AppendUnsigned(getpid());
+      out.Append(", tid ");
+      out.AppendUnsigned(syscall(SYS_gettid));
+      out.Append(" ***\n");
+    }
+    WriteStackTrace(STDERR_FILENO);
+    for (const auto& callback : g_callbacks) {
+      if (CrashCallback run = callback.load(std::memory_order_acquire))
+        run();
+    }
+  }
+  // Hand the signal to whoever had it before, and let it kill the process.
+  for (size_t i = 0; i < std::size(kFatalSignals); i++) {
+    if (kFatalSignals[i] == signal)
+      sigaction(signal, &g_previous_actions[i], nullptr);
+  }
+  errno = saved_errno;
+  raise(signal);
+}
+
+}  // namespace
+
+void InstallCrashHandler() {
+  if (g_installed.exchange(true))
+    return;
+  // backtrace() loads libgcc's unwinder, allocating, the first time it's
+  // called; get that done here rather than in the handler.
+  void* frames[1];
+  backtrace(frames, 1);
+
+  stack_t stack;
+  memset(&stack, 0, sizeof(stack));
+  stack.ss_sp = g_alternate_stack;
+  stack.ss_size = sizeof(g_alternate_stack);
+  sigaltstack(&stack, nullptr);
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  sigemptyset(&action.sa_mask);
+  action.sa_sigaction = &OnFatalSignal;
+  action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+  for (size_t i = 0; i < std::size(kFatalSignals); i++)
+    sigaction(kFatalSignals[i], &action, &g_previous_actions[i]);
+}
+
+bool AddCrashCallback(CrashCallback callback) {
+  int index = g_callback_count.load(std::memory_order_relaxed);
+  do {
+    if (index == kMaxCrashCallbacks)
+      return false;
+  } while (!g_callback_count.compare_exchange_weak(index, index + 1));
+  g_callbacks[index].store(callback, std::memory_order_release);
+  return true;
+}
+
+void WriteStackTrace(int fd) {
+  void* frames[kMaxFrames];
+  int count = backtrace(frames, kMaxFrames);
+  size_t maps_size = ReadMaps();
+  SignalSafeWriter out(fd);
+  for (int i = 0; i < count; i++) {
+    out.Append("#");
+    out.AppendUnsigned(i);
+    out.Append(" 0x");
+    uintptr_t address = reinterpret_cast<uintptr_t>(frames[i]);
+    out.AppendHex(address);
+    out.Append(" ");
+    AppendModuleOffset(out, address, maps_size);
+    out.Append("\n");
+  }
+}
+
+}  // namespace base
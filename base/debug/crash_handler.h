@@ -0,0 +1,37 @@
+#ifndef BASE_DEBUG_CRASH_HANDLER_H_
+#define BASE_DEBUG_CRASH_HANDLER_H_
+
+namespace base {
+
+// Runs inside the crash handler, so must be async-signal-safe: no allocating,
+// no locking, no stdio.
+using CrashCallback = void (*)();
+
+// Installs handlers for SIGSEGV, SIGBUS, SIGILL, SIGFPE and SIGABRT which
+// write the signal and a stack trace to stderr, run the crash callbacks, and
+// then hand the signal on to whichever handler was there before. Nothing in
+// the handler allocates. Frames are printed as the module that contains them
+// and the offset into it, read from /proc/self/maps when the crash happens,
+// for symbolizing offline:
+//
+//   #3 0x55d1c0a1b2c3 /usr/bin/app+0x1b2c3
+//
+//   addr2line -Cfipe /usr/bin/app 0x1b2c3
+//
+// The installing thread also gets an alternate signal stack, so that it can
+// report running out of stack. Installing more than once does nothing.
+void InstallCrashHandler();
+
+// Adds |callback| to those run on a crash, in the order added. Returns false
+// if there are already kMaxCrashCallbacks.
+constexpr int kMaxCrashCallbacks = 8;
+bool AddCrashCallback(CrashCallback callback);
+
+// Writes the calling thread's stack to |fd| in the format above. Safe to call
+// from a signal handler once InstallCrashHandler() has run, but from only one
+// thread at a time.
+void WriteStackTrace(int fd);
+
+}  // namespace base
+
+#endif  // BASE_DEBUG_CRASH_HANDLER_H_
@@ -0,0 +1,105 @@
+#ifndef BASE_DEBUG_SIGNAL_SAFE_WRITER_H_
+#define BASE_DEBUG_SIGNAL_SAFE_WRITER_H_
+
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace base {
+
+// Formats text into a buffer on the stack and hands it to write(2) in large
+// pieces, flushing when full and when destroyed. Neither allocates nor locks,
+// so it may be used from a signal handler.
+class SignalSafeWriter {
+ public:
+  explicit SignalSafeWriter(int fd) : fd_(fd) {}
+  ~SignalSafeWriter() { Flush(); }
+
+  SignalSafeWriter(const SignalSafeWriter&) = delete;
+  SignalSafeWriter& operator=(const SignalSafeWriter&) = delete;
+
+  void Append(const char* str) { Append(str, strlen(str)); }
+
+  void Append(const char* str, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+      if (size_ == sizeof(buffer_))
+        Flush();
+      buffer_[size_++] = str[i];
+    }
+  }
+
+  void AppendUnsigned(uint64_t value) {
+    char digits[20];
+    size_t count = 0;
+    do {
+      digits[count++] = static_cast<char>('0' + value % 10);
+      value /= 10;
+    } while (value);
+    while (count)
+      Append(&digits[--count], 1);
+  }
+
+  void AppendSigned(int64_t value) {
+    if (value < 0)
+      Append("-", 1);
+    AppendUnsigned(value < 0 ? 0 - static_cast<uint64_t>(value) : value);
+  }
+
+  // Lower case, without a "0x" prefix.
+  void AppendHex(uint64_t value) {
+    char digits[16];
+    size_t count = 0;
+    do {
+      digits[count++] = "0123456789abcdef"[value % 16];
+      value /= 16;
+    } while (value);
+    while (count)
+      Append(&digits[--count], 1);
+  }
+
+  // With six decimal places and no exponent, so values beyond 2^64 come out
+  // as "null".
+  void AppendDouble(double value) {
+    if (!(value > -1.8e19 && value < 1.8e19)) {
+      Append("null");
+      return;
+    }
+    if (value < 0) {
+      Append("-", 1);
+      value = -value;
+    }
+    uint64_t integer = static_cast<uint64_t>(value);
+    uint64_t micros = static_cast<uint64_t>((value - integer) * 1e6 + 0.5);
+    if (micros == 1000000) {
+      integer++;
+      micros = 0;
+    }
+    AppendUnsigned(integer);
+    char fraction[7] = {'.'};
+    for (size_t i = 6; i > 0; i--, micros /= 10)
+      fraction[i] = static_cast<char>('0' + micros % 10);
+    Append(fraction, sizeof(fraction));
+  }
+
+  void Flush() {
+    size_t written = 0;
+    while (written < size_) {
+      ssize_t result = write(fd_, buffer_ + written, size_ - written);
+      if (result <= 0)
+        break;
+      written += result;
+    }
+    size_ = 0;
+  }
+
+ private:
+  const int fd_;
+  char buffer_[4096];
+  size_t size_ = 0;
+};
+
+}  // namespace base
+
+#endif  // BASE_DEBUG_SIGNAL_SAFE_WRITER_H_
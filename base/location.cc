@@ -0,0 +1,123 @@
+#include "base/location.h"
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+namespace base {
+
+namespace {
+
+struct LocationKey {
+  std::string_view file_name;
+  int line_number;
+  std::string_view function_name;
+
+  bool operator==(const LocationKey& other) const {
+    return line_number == other.line_number && file_name == other.file_name &&
+           function_name == other.function_name;
+  }
+};
+
+struct LocationKeyHash {
+  size_t operator()(const LocationKey& key) const {
+    std::hash<std::string_view> hash;
+    return hash(key.file_name) * 31 + hash(key.function_name) * 7 +
+           key.line_number;
+  }
+};
+
+// Interns by content, since a header's file name is a different string in
+// every translation unit that includes it. Names are string literals, so
+// they're kept rather than copied.
+class LocationRegistry {
+ public:
+  LocationRegistry() { entries_.push_back({"__none__", 0, ""}); }
+
+  uint32_t Intern(const char* file, int line, const char* function) {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto [it, inserted] = ids_.try_emplace(
+        LocationKey{file, line, function},
+        static_cast<uint32_t>(entries_.size()));
+    if (inserted)
+      entries_.push_back({file, line, function});
+    return it->second;
+  }
+
+  // Entries never move once added.
+  const LocationInfo& Get(uint32_t id) {
+    std::lock_guard<std::mutex> lock(lock_);
+    return id < entries_.size() ? entries_[id] : entries_[0];
+  }
+
+  uint32_t size() {
+    std::lock_guard<std::mutex> lock(lock_);
+    return static_cast<uint32_t>(entries_.size());
+  }
+
+ private:
+  std::mutex lock_;
+  std::deque<LocationInfo> entries_;
+  std::unordered_map<LocationKey, uint32_t, LocationKeyHash> ids_;
+};
+
+LocationRegistry& Registry() {
+  // Never destroyed, so locations can be resolved during shutdown.
+  static LocationRegistry* registry = new LocationRegistry();
+  return *registry;
+}
+
+// Each thread remembers the call sites it interned recently, so that the
+// registry's lock is only taken the first time a thread passes through one.
+struct CachedLocation {
+  const char* file_name;
+  const char* function_name;
+  int line_number;
+  uint32_t id;
+};
+
+constexpr size_t kCachedLocations = 256;
+thread_local CachedLocation t_cached_locations[kCachedLocations];
+
+// Kept out of line so that a cache hit needs no stack frame.
+__attribute__((noinline)) uint32_t InternAndCache(CachedLocation& cached,
+                                                  const char* file,
+                                                  int line,
+                                                  const char* function) {
+  uint32_t id = Registry().Intern(file, line, function);
+  cached = {file, function, line, id};
+  return id;
+}
+
+}  // namespace
+
+// static
+uint32_t Location::Intern(const char* file, int line, const char* function) {
+  // Nearby lines of a file get neighbouring slots.
+  uintptr_t slot = (reinterpret_cast<uintptr_t>(file) >> 4) + line;
+  CachedLocation& cached = t_cached_locations[slot % kCachedLocations];
+  if (cached.file_name == file && cached.line_number == line &&
+      cached.function_name == function) {
+    return cached.id;
+  }
+  return InternAndCache(cached, file, line, function);
+}
+
+// static
+uint32_t Location::RegisteredCount() {
+  return Registry().size();
+}
+
+const LocationInfo& Location::info() const {
+  return Registry().Get(id_);
+}
+
+std::string Location::ToString() const {
+  const LocationInfo& location = info();
+  return std::string(location.file_name) + ":" +
+         std::to_string(location.line_number);
+}
+
+}  // namespace base
@@ -2,23 +2,91 @@
 #ifndef BASE_LOCATION_H_
 #define BASE_LOCATION_H_
 
+#include <cstdint>
+#include <string>
+
+#if __cplusplus >= 202002L && __has_include(<source_location>)
+#include <source_location>
+#define BASE_HAS_SOURCE_LOCATION 1
+#endif
+
 namespace base {
 
+// A call site's file, line and function.
+struct LocationInfo {
+  const char* file_name;
+  int line_number;
+  const char* function_name;
+};
+
+// A source location, as a 4 byte ID into a process-wide registry in which
+// each call site is interned once. Locations are cheap to store and compare;
+// resolve them to names only when reporting.
 class Location {
  public:
-  char* filename;
-  int line_number;
+  // A call site before it's interned, for code that only sometimes needs its
+  // Location: capturing one costs nothing, and the registry is only consulted
+  // when it's converted.
+  class Site {
+   public:
+#if defined(BASE_HAS_SOURCE_LOCATION)
+    static Site Current(const std::source_location& location =
+                            std::source_location::current()) {
+      return Site(location.file_name(), location.line(),
+                  location.function_name());
+    }
+#else
+    static Site Current(const char* file = __builtin_FILE(),
+                        int line = __builtin_LINE(),
+                        const char* function = __builtin_FUNCTION()) {
+      return Site(file, line, function);
+    }
+#endif
+
+    operator Location() const {
+      return Location(Intern(file_, line_, function_));
+    }
+
+   private:
+    Site(const char* file, int line, const char* function)
+        : file_(file), function_(function), line_(line) {}
+
+    const char* file_;
+    const char* function_;
+    int line_;
+  };
 
-  static Location Current(const char* file = __builtin_FILE(),
-                          int line = __builtin_LINE()) {
-    return Location(file, line);
-  }
+  static Location Current(const Site& site = Site::Current()) { return site; }
 
-  Location() : Location("__none__", 0) {}
+  // |id| must come from id().
+  static Location FromId(uint32_t id) { return Location(id); }
+
+  // The number of locations interned so far, including the default one. IDs
+  // are below this.
+  static uint32_t RegisteredCount();
+
+  // Nowhere: "__none__", line 0.
+  Location() = default;
+
+  uint32_t id() const { return id_; }
+
+  const LocationInfo& info() const;
+  const char* file_name() const { return info().file_name; }
+  int line_number() const { return info().line_number; }
+  const char* function_name() const { return info().function_name; }
+
+  // "file:line".
+  std::string ToString() const;
+
+  bool operator==(const Location& other) const { return id_ == other.id_; }
+  bool operator!=(const Location& other) const { return id_ != other.id_; }
 
  private:
-  Location(const char* file, int line)
-      : filename((char*)file), line_number(line) {}
+  explicit Location(uint32_t id) : id_(id) {}
+
+  static uint32_t Intern(const char* file, int line, const char* function);
+
+  uint32_t id_ = 0;
 };
 
 }  // namespace base
@@ -0,0 +1,106 @@
+#include "base/location.h"
+
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+
+namespace base {
+namespace {
+
+// Always the same call site.
+Location FixedSite() {
+  return Location::Current();
+}
+
+Location Caller(const Location& location = Location::Current()) {
+  return location;
+}
+
+TEST(LocationTest, DefaultIsNowhere) {
+  Location location;
+  EXPECT_EQ(location.id(), 0u);
+  EXPECT_STREQ(location.file_name(), "__none__");
+  EXPECT_EQ(location.line_number(), 0);
+  EXPECT_EQ(location.ToString(), "__none__:0");
+}
+
+TEST(LocationTest, CurrentResolvesToTheCallSite) {
+  int line = __LINE__ + 1;
+  Location location = Location::Current();
+  EXPECT_NE(location.id(), 0u);
+  EXPECT_STREQ(location.file_name(), __FILE__);
+  EXPECT_EQ(location.line_number(), line);
+  EXPECT_NE(strstr(location.function_name(), "TestBody"), nullptr);
+  EXPECT_EQ(location.ToString(), std::string(__FILE__) + ":" +
+                                     std::to_string(line));
+}
+
+TEST(LocationTest, DefaultArgumentIsTheCaller) {
+  int line = __LINE__ + 1;
+  Location location = Caller();
+  EXPECT_EQ(location.line_number(), line);
+  EXPECT_NE(location, FixedSite());
+}
+
+TEST(LocationTest, SameSiteInternsOnce) {
+  Location first = FixedSite();
+  uint32_t count = Location::RegisteredCount();
+  for (int i = 0; i < 100; i++)
+    EXPECT_EQ(FixedSite(), first);
+  EXPECT_EQ(Location::RegisteredCount(), count);
+  EXPECT_LT(first.id(), count);
+}
+
+TEST(LocationTest, DifferentSitesDiffer) {
+  Location first = Location::Current();
+  Location second = Location::Current();
+  EXPECT_NE(first, second);
+  EXPECT_NE(first.id(), second.id());
+}
+
+TEST(LocationTest, FromIdRoundTrips) {
+  Location location = Location::Current();
+  Location copy = Location::FromId(location.id());
+  EXPECT_EQ(copy, location);
+  EXPECT_EQ(copy.file_name(), location.file_name());
+  EXPECT_EQ(copy.line_number(), location.line_number());
+  EXPECT_EQ(copy.function_name(), location.function_name());
+}
+
+TEST(LocationTest, UnknownIdIsNowhere) {
+  Location location = Location::FromId(Location::RegisteredCount() + 1000);
+  EXPECT_STREQ(location.file_name(), "__none__");
+  EXPECT_EQ(location.line_number(), 0);
+}
+
+TEST(LocationTest, SiteInternsOnConversion) {
+  uint32_t count = Location::RegisteredCount();
+  Location::Site site = Location::Site::Current();
+  EXPECT_EQ(Location::RegisteredCount(), count);
+  Location location = site;
+  EXPECT_EQ(Location::RegisteredCount(), count + 1);
+  EXPECT_EQ(location, static_cast<Location>(site));
+}
+
+TEST(LocationTest, ThreadsAgreeOnIds) {
+  Location expected = FixedSite();
+  std::vector<std::thread> threads;
+  std::vector<uint32_t> ids(8);
+  for (size_t i = 0; i < ids.size(); i++)
+    threads.emplace_back([&ids, i]() { ids[i] = FixedSite().id(); });
+  for (std::thread& thread : threads)
+    thread.join();
+  for (uint32_t id : ids)
+    EXPECT_EQ(id, expected.id());
+}
+
+}  // namespace
+}  // namespace base
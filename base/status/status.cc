@@ -1,5 +1,9 @@
 #include "base/status/status.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
 #include <memory>
 
 namespace base {
@@ -8,37 +12,248 @@ namespace internal {
 
 StatusData::StatusData() = default;
 
-StatusData::StatusData(const StatusData& copy) {
-  *this = copy;
+StatusData::StatusData(std::string message) : message(std::move(message)) {}
+
+StatusData::StatusData(const StatusData& copy)
+    : message(copy.message),
+      frames(copy.frames),
+      format(copy.format),
+      format_arg_count(copy.format_arg_count),
+      format_strings_size(copy.format_strings_size) {
+  std::copy_n(copy.format_args, format_arg_count, format_args);
+  memcpy(format_strings, copy.format_strings, format_strings_size);
 }
 
-StatusData::StatusData(StatusGroupType group,
-                       StatusCodeType code,
-                       std::string message)
-    : group(group), code(code), message(std::move(message)) {}
+StatusData::~StatusData() = default;
 
-std::unique_ptr<StatusData> StatusData::copy() const {
-  auto result = std::make_unique<StatusData>(group, code, message);
-  for (const auto& frame : frames)
-    result->frames.push_back(frame);
-  return result;
+const std::string& StatusData::Message() const {
+  if (!format)
+    return message;
+  std::call_once(rendered, [this] {
+    std::string text;
+    size_t next = 0;
+    for (const char* c = format; *c; c++) {
+      if (c[0] != '{' || c[1] != '}' || next == format_arg_count) {
+        text.push_back(*c);
+        continue;
+      }
+      c++;
+      const StatusFormatArg& arg = format_args[next++];
+      char number[32];
+      switch (arg.type) {
+        case StatusFormatArg::kInt:
+          text.append(std::to_string(arg.int_value));
+          break;
+        case StatusFormatArg::kUint:
+          text.append(std::to_string(arg.uint_value));
+          break;
+        case StatusFormatArg::kDouble:
+          snprintf(number, sizeof(number), "%g", arg.double_value);
+          text.append(number);
+          break;
+        case StatusFormatArg::kBool:
+          text.append(arg.bool_value ? "true" : "false");
+          break;
+        case StatusFormatArg::kChar:
+          text.push_back(arg.char_value);
+          break;
+        case StatusFormatArg::kPointer:
+          snprintf(number, sizeof(number), "%p", arg.pointer_value);
+          text.append(number);
+          break;
+        case StatusFormatArg::kString:
+          text.append(format_strings + arg.string_value.offset,
+                      arg.string_value.size);
+          break;
+      }
+    }
+    message = std::move(text);
+  });
+  return message;
 }
 
-StatusData::~StatusData() = default;
+void StatusData::AddFormatString(std::string_view string) {
+  StatusFormatArg& added = format_args[format_arg_count++];
+  size_t size = std::min(string.size(),
+                         kMaxFormatStringBytes - format_strings_size);
+  added.type = StatusFormatArg::kString;
+  added.string_value.offset = format_strings_size;
+  added.string_value.size = static_cast<uint16_t>(size);
+  memcpy(format_strings + format_strings_size, string.data(), size);
+  format_strings_size += size;
+}
+
+StatusData* StatusDataRef::Mutable() {
+  if (!data_) {
+    data_ = new StatusData();
+  } else if (data_->ref_count.load(std::memory_order_acquire) != 1) {
+    StatusData* fork = new StatusData(*data_);
+    Release(data_);
+    data_ = fork;
+  }
+  return data_;
+}
+
+// static
+void StatusDataRef::Release(StatusData* data) {
+  if (data->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    delete data;
+}
+
+const std::string& EmptyStatusMessage() {
+  static const std::string empty;
+  return empty;
+}
+
+namespace {
+
+// One thread's error counts, keyed by group ID and code in an open-addressed
+// table. Only the owning thread writes, with plain stores, so counting never
+// contends; collecting reads a possibly slightly stale copy.
+class ThreadStatusCounters {
+ public:
+  static constexpr size_t kSlots = 256;
+
+  void Count(uint32_t group_id, StatusCodeType code) {
+    // Zero marks an empty slot.
+    uint64_t key = (uint64_t{group_id} << 16 | code) + 1;
+    size_t start = (key * 0x9e3779b97f4a7c15u) >> 32;
+    for (size_t i = 0; i < kSlots; i++) {
+      Slot& slot = slots_[(start + i) % kSlots];
+      uint64_t slot_key = slot.key.load(std::memory_order_relaxed);
+      if (slot_key == key) {
+        Increment(slot.count);
+        return;
+      }
+      if (!slot_key) {
+        slot.count.store(1, std::memory_order_relaxed);
+        slot.key.store(key, std::memory_order_release);
+        return;
+      }
+    }
+    Increment(uncounted_);
+  }
+
+  template <typename Visitor>
+  void ForEach(Visitor visit) const {
+    for (const Slot& slot : slots_) {
+      uint64_t key = slot.key.load(std::memory_order_acquire);
+      if (key) {
+        visit(static_cast<uint32_t>((key - 1) >> 16),
+              static_cast<StatusCodeType>(key - 1),
+              slot.count.load(std::memory_order_relaxed));
+      }
+    }
+  }
+
+  uint64_t uncounted() const {
+    return uncounted_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> key = 0;
+    std::atomic<uint64_t> count = 0;
+  };
+
+  static void Increment(std::atomic<uint64_t>& counter) {
+    counter.store(counter.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_relaxed);
+  }
+
+  Slot slots_[kSlots];
+  std::atomic<uint64_t> uncounted_ = 0;
+};
+
+// Every thread's counters, kept after the thread exits so its counts still
+// add up, and handed on to the next new thread so that they don't pile up.
+class StatusCounterRegistry {
+ public:
+  uint32_t RegisterGroup(StatusGroupType group) {
+    std::lock_guard<std::mutex> guard(lock_);
+    for (size_t i = 0; i < groups_.size(); i++) {
+      if (groups_[i] == group)
+        return static_cast<uint32_t>(i);
+    }
+    groups_.push_back(group);
+    return static_cast<uint32_t>(groups_.size() - 1);
+  }
+
+  ThreadStatusCounters* Acquire() {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!unused_.empty()) {
+      ThreadStatusCounters* counters = unused_.back();
+      unused_.pop_back();
+      return counters;
+    }
+    threads_.push_back(std::make_unique<ThreadStatusCounters>());
+    return threads_.back().get();
+  }
+
+  void Release(ThreadStatusCounters* counters) {
+    std::lock_guard<std::mutex> guard(lock_);
+    unused_.push_back(counters);
+  }
+
+  std::vector<StatusCount> Collect(uint64_t* uncounted) {
+    std::lock_guard<std::mutex> guard(lock_);
+    std::map<std::pair<uint32_t, StatusCodeType>, uint64_t> totals;
+    *uncounted = 0;
+    for (const auto& counters : threads_) {
+      counters->ForEach([&totals](uint32_t group_id, StatusCodeType code,
+                                  uint64_t count) {
+        totals[{group_id, code}] += count;
+      });
+      *uncounted += counters->uncounted();
+    }
+    std::vector<StatusCount> counts;
+    for (const auto& [key, count] : totals)
+      counts.push_back({groups_[key.first], key.second, count});
+    return counts;
+  }
+
+ private:
+  std::mutex lock_;
+  std::vector<StatusGroupType> groups_;
+  std::vector<std::unique_ptr<ThreadStatusCounters>> threads_;
+  std::vector<ThreadStatusCounters*> unused_;
+};
+
+StatusCounterRegistry& CounterRegistry() {
+  // Never destroyed, so threads still running at exit can keep counting.
+  static StatusCounterRegistry* registry = new StatusCounterRegistry();
+  return *registry;
+}
+
+thread_local ThreadStatusCounters* t_status_counters = nullptr;
+
+// Returns the thread's counters to the registry when it exits.
+struct ThreadStatusCountersOwner {
+  ~ThreadStatusCountersOwner() {
+    if (t_status_counters)
+      CounterRegistry().Release(t_status_counters);
+    t_status_counters = nullptr;
+  }
+};
+
+}  // namespace
+
+uint32_t RegisterStatusGroup(StatusGroupType group) {
+  return CounterRegistry().RegisterGroup(group);
+}
 
-StatusData& StatusData::operator=(const StatusData& copy) {
-  group = copy.group;
-  code = copy.code;
-  message = copy.message;
-  for (const auto& frame : copy.frames)
-    frames.push_back(frame);
-  return *this;
+void CountStatus(uint32_t group_id, StatusCodeType code) {
+  if (!t_status_counters) {
+    thread_local ThreadStatusCountersOwner owner;
+    t_status_counters = CounterRegistry().Acquire();
+  }
+  t_status_counters->Count(group_id, code);
 }
 
-void StatusData::AddLocation(const base::Location& location) {
-  frames.push_back(location);
+std::vector<StatusCount> CollectStatusCounts(uint64_t* uncounted) {
+  return CounterRegistry().Collect(uncounted);
 }
 
 }  // namespace internal
 
-}  // namespace base
\ No newline at end of file
+}  // namespace base
@@ -1,9 +1,14 @@
 #ifndef BASE_STATUS_STATUS_H_
 #define BASE_STATUS_STATUS_H_
 
-#include <memory>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -18,21 +23,174 @@ using StatusGroupType = std::string_view;
 
 namespace internal {
 
+// The format string of TypedStatus::Format(), and where it was called.
+struct StatusFormatString {
+  template <size_t N>
+  StatusFormatString(const char (&format)[N],
+                     const Location::Site& site = Location::Site::Current())
+      : format(format), site(site) {}
+
+  const char* format;
+  Location::Site site;
+};
+
+// An argument to TypedStatus::Format(), kept until the message is rendered.
+struct StatusFormatArg {
+  enum Type : uint8_t { kInt, kUint, kDouble, kBool, kChar, kPointer, kString };
+
+  Type type;
+  union {
+    int64_t int_value;
+    uint64_t uint_value;
+    double double_value;
+    bool bool_value;
+    char char_value;
+    const void* pointer_value;
+    // A range of StatusData::format_strings.
+    struct {
+      uint16_t offset;
+      uint16_t size;
+    } string_value;
+  };
+};
+
+// The parts of an error that need the heap: its message, if it has one, and
+// any frames beyond those a TypedStatus holds inline. Shared by every copy of
+// a status, and immutable while shared, except that a deferred message is
+// rendered into |message| the first time it's asked for.
 struct StatusData {
+  static constexpr size_t kMaxFormatArgs = 6;
+  // String arguments share this many bytes between them, and are truncated
+  // once they run out.
+  static constexpr size_t kMaxFormatStringBytes = 64;
+
   StatusData();
+  explicit StatusData(std::string message);
+  // Starts with a reference count of one.
   StatusData(const StatusData&);
-  StatusData(StatusGroupType group, StatusCodeType code, std::string message);
   ~StatusData();
-  StatusData& operator=(const StatusData&);
+  StatusData& operator=(const StatusData&) = delete;
+
+  const std::string& Message() const;
+
+  // A null string is rendered as "(null)".
+  void AddFormatArg(const char* arg) { AddFormatString(arg ? arg : "(null)"); }
+
+  template <typename Arg>
+  void AddFormatArg(const Arg& arg) {
+    if constexpr (std::is_convertible<const Arg&, const char*>::value) {
+      AddFormatArg(static_cast<const char*>(arg));
+    } else if constexpr (std::is_convertible<const Arg&,
+                                             std::string_view>::value) {
+      AddFormatString(arg);
+    } else if constexpr (std::is_enum<Arg>::value) {
+      AddFormatArg(static_cast<std::underlying_type_t<Arg>>(arg));
+    } else {
+      StatusFormatArg& added = format_args[format_arg_count++];
+      if constexpr (std::is_same<Arg, bool>::value) {
+        added.type = StatusFormatArg::kBool;
+        added.bool_value = arg;
+      } else if constexpr (std::is_same<Arg, char>::value) {
+        added.type = StatusFormatArg::kChar;
+        added.char_value = arg;
+      } else if constexpr (std::is_floating_point<Arg>::value) {
+        added.type = StatusFormatArg::kDouble;
+        added.double_value = arg;
+      } else if constexpr (std::is_integral<Arg>::value &&
+                           std::is_signed<Arg>::value) {
+        added.type = StatusFormatArg::kInt;
+        added.int_value = arg;
+      } else if constexpr (std::is_integral<Arg>::value) {
+        added.type = StatusFormatArg::kUint;
+        added.uint_value = arg;
+      } else {
+        static_assert(std::is_pointer<Arg>::value,
+                      "TypedStatus::Format() arguments must be numbers, "
+                      "enums, pointers or strings.");
+        added.type = StatusFormatArg::kPointer;
+        added.pointer_value = arg;
+      }
+    }
+  }
 
-  std::unique_ptr<StatusData> copy() const;
-  void AddLocation(const Location&);
-  std::string group;
-  StatusCodeType code;
-  std::string message;
+  void AddFormatString(std::string_view string);
+
+  mutable std::string message;
   std::vector<Location> frames;
+  mutable std::atomic<uint32_t> ref_count = 1;
+
+  // Set if |message| is still to be rendered from these.
+  const char* format = nullptr;
+  StatusFormatArg format_args[kMaxFormatArgs];
+  uint8_t format_arg_count = 0;
+  uint8_t format_strings_size = 0;
+  char format_strings[kMaxFormatStringBytes];
+  mutable std::once_flag rendered;
 };
 
+// An intrusive reference to a StatusData. Copies share it for the cost of an
+// atomic increment; Mutable() forks it if it is shared.
+class StatusDataRef {
+ public:
+  StatusDataRef() = default;
+
+  // Adopts |data|'s initial reference.
+  explicit StatusDataRef(StatusData* data) : data_(data) {}
+
+  StatusDataRef(const StatusDataRef& other) : data_(other.data_) {
+    if (data_)
+      data_->ref_count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  StatusDataRef(StatusDataRef&& other) noexcept
+      : data_(std::exchange(other.data_, nullptr)) {}
+
+  StatusDataRef& operator=(StatusDataRef other) noexcept {
+    std::swap(data_, other.data_);
+    return *this;
+  }
+
+  ~StatusDataRef() {
+    if (data_)
+      Release(data_);
+  }
+
+  explicit operator bool() const { return data_; }
+  const StatusData* operator->() const { return data_; }
+
+  // |data_| for writing, created or forked as needed.
+  StatusData* Mutable();
+
+ private:
+  static void Release(StatusData* data);
+
+  StatusData* data_ = nullptr;
+};
+
+const std::string& EmptyStatusMessage();
+
+// Set while StatusMetrics is counting.
+inline std::atomic<bool> status_metrics_enabled = false;
+
+uint32_t RegisterStatusGroup(StatusGroupType group);
+void CountStatus(uint32_t group_id, StatusCodeType code);
+
+struct StatusCount {
+  StatusGroupType group;
+  StatusCodeType code;
+  uint64_t count;
+};
+
+// Every group and code counted so far, summed over threads. |uncounted| is
+// set to the errors that didn't fit in their thread's table.
+std::vector<StatusCount> CollectStatusCounts(uint64_t* uncounted);
+
+template <typename T>
+uint32_t StatusGroupId() {
+  static const uint32_t id = RegisterStatusGroup(T::Group());
+  return id;
+}
+
 template <typename T>
 struct StatusTraitsHelper {
   static constexpr std::optional<typename T::Codes> DefaultEnumValue() {
@@ -59,7 +217,7 @@ struct StatusTraitsHelper {
 }  // namespace internal
 
 template <typename T>
-class TypedStatus {
+class [[nodiscard]] TypedStatus {
   static_assert(std::is_enum<typename T::Codes>::value,
                 "TypedStatus Traits::Codes must be an enum type.");
   static_assert(std::is_same<decltype(T::Group), StatusGroupType()>::value,
@@ -68,45 +226,84 @@ class TypedStatus {
  public:
   using Traits = T;
   using Codes = typename T::Codes;
+
+  // Frames beyond this many go to the heap.
+  static constexpr size_t kInlineFrames = 4;
+
+  // Only errors with a message allocate.
   TypedStatus(Codes code,
-              std::string message = "",
-              const Location& location = Location::Current()) {
+              std::string message = {},
+              const Location::Site& site = Location::Site::Current()) {
     if (code == internal::StatusTraitsHelper<T>::DefaultEnumValue()) {
       CHECK(!!message.empty());
       return;
     }
-    data_ = std::make_unique<internal::StatusData>(
-        T::Group(), static_cast<StatusCodeType>(code), std::string(message));
-    data_->AddLocation(location);
+    is_error_ = true;
+    code_ = static_cast<StatusCodeType>(code);
+    if (internal::status_metrics_enabled.load(std::memory_order_relaxed))
+      internal::CountStatus(internal::StatusGroupId<T>(), code_);
+    if (!message.empty())
+      data_ = internal::StatusDataRef(
+          new internal::StatusData(std::move(message)));
+    AddLocation(site);
   }
 
-  TypedStatus(const TypedStatus<T>& copy) { *this = copy; }
-
-  TypedStatus<T>& operator=(const TypedStatus<T>& copy) {
-    if (!copy.data_) {
-      data_.reset();
-      return *this;
-    }
-    data_ = copy.data_->copy();
-    return *this;
+  // An error whose message is only rendered if message() is called, so that
+  // errors which are checked and dropped cost no formatting. Each "{}" in
+  // |format| is replaced by the next of |args|, which may be numbers, enums,
+  // pointers or strings; strings are copied, up to a shared limit of
+  // StatusData::kMaxFormatStringBytes, and null C strings become "(null)".
+  //
+  //   return ParseStatus::Format(Codes::kMissingKey, "no key {} at offset {}",
+  //                              key, offset);
+  template <typename... Args>
+  static TypedStatus<T> Format(Codes code,
+                               internal::StatusFormatString format,
+                               const Args&... args) {
+    static_assert(sizeof...(Args) <= internal::StatusData::kMaxFormatArgs,
+                  "Too many TypedStatus::Format() arguments.");
+    TypedStatus<T> status(code, {}, format.site);
+    CHECK(status.is_error_);
+    internal::StatusData* data = status.data_.Mutable();
+    data->format = format.format;
+    (data->AddFormatArg(args), ...);
+    return status;
   }
 
+  // Copies share the message and any overflow frames.
+  TypedStatus(const TypedStatus<T>&) = default;
+  TypedStatus(TypedStatus<T>&&) = default;
+  TypedStatus<T>& operator=(const TypedStatus<T>&) = default;
+  TypedStatus<T>& operator=(TypedStatus<T>&&) = default;
+
   Codes code() const {
-    if (!data_)
+    if (!is_error_)
       return *internal::StatusTraitsHelper<T>::DefaultEnumValue();
-    return static_cast<Codes>(data_->code);
+    return static_cast<Codes>(code_);
   }
 
-  const std::string group() const { return data_ ? data_->group : T::Group(); }
+  StatusGroupType group() const { return T::Group(); }
+
+  bool has_error() const { return is_error_; }
 
   const std::string& message() const {
-    CHECK(data_);
-    return data_->message;
+    CHECK(is_error_);
+    return data_ ? data_->Message() : internal::EmptyStatusMessage();
+  }
+
+  // Where the error was created, followed by every AddHere().
+  size_t frame_count() const { return frame_count_; }
+
+  const Location& frame(size_t index) const {
+    CHECK(index < frame_count_);
+    return index < kInlineFrames ? frames_[index]
+                                 : data_->frames[index - kInlineFrames];
   }
 
-  TypedStatus<T>&& AddHere(const Location& location = Location::Current()) && {
-    CHECK(data_);
-    data_->AddLocation(location);
+  TypedStatus<T>&& AddHere(
+      const Location::Site& site = Location::Site::Current()) && {
+    CHECK(is_error_);
+    AddLocation(site);
     return std::move(*this);
   }
 
@@ -122,31 +319,59 @@ class TypedStatus {
     return other.code() != code();
   }
 
+  // Either an error or an |OtherType|, in the space of the larger of the two
+  // plus a flag.
   template <typename OtherType>
-  class Or {
+  class [[nodiscard]] Or {
    public:
-    ~Or() = default;
-    Or(TypedStatus<T>&& error) : error_(std::move(error)) {
+    Or(TypedStatus<T>&& error) : has_value_(false) {
+      new (&error_) TypedStatus<T>(std::move(error));
       CHECK(!internal::StatusTraitsHelper<T>::DefaultEnumValue() ||
             *internal::StatusTraitsHelper<T>::DefaultEnumValue() != code());
     }
-    Or(const TypedStatus<T>& error) : error_(error) {
+    Or(const TypedStatus<T>& error) : has_value_(false) {
+      new (&error_) TypedStatus<T>(error);
       CHECK(!internal::StatusTraitsHelper<T>::DefaultEnumValue() ||
             *internal::StatusTraitsHelper<T>::DefaultEnumValue() != code());
     }
 
-    Or(OtherType&& value) : value_(std::move(value)) {}
-    Or(typename T::Codes code, const Location& location = Location::Current())
-        : error_(TypedStatus<T>(code, "", location)) {
+    Or(OtherType&& value) : has_value_(true) {
+      new (&value_) OtherType(std::move(value));
+    }
+    Or(const OtherType& value) : has_value_(true) {
+      new (&value_) OtherType(value);
+    }
+    Or(typename T::Codes code,
+       const Location::Site& site = Location::Site::Current())
+        : has_value_(false) {
+      new (&error_) TypedStatus<T>(code, {}, site);
       CHECK(!internal::StatusTraitsHelper<T>::DefaultEnumValue() ||
             *internal::StatusTraitsHelper<T>::DefaultEnumValue() != code);
     }
 
-    Or(Or&&) = default;
-    Or& operator=(Or&&) = default;
+    Or(Or&& other) : has_value_(other.has_value_) {
+      if (has_value_)
+        new (&value_) OtherType(std::move(other.value_));
+      else
+        new (&error_) TypedStatus<T>(std::move(other.error_));
+    }
 
-    bool has_value() const { return value_.has_value(); }
-    bool has_error() const { return error_.has_value(); }
+    Or& operator=(Or&& other) {
+      if (this == &other)
+        return *this;
+      Destroy();
+      has_value_ = other.has_value_;
+      if (has_value_)
+        new (&value_) OtherType(std::move(other.value_));
+      else
+        new (&error_) TypedStatus<T>(std::move(other.error_));
+      return *this;
+    }
+
+    ~Or() { Destroy(); }
+
+    bool has_value() const { return has_value_; }
+    bool has_error() const { return !has_value_; }
 
     inline bool operator==(typename T::Codes code) const {
       return code == this->code();
@@ -156,35 +381,69 @@ class TypedStatus {
       return code != this->code();
     }
 
-    TypedStatus<T> error() && {
-      CHECK(error_);
-      auto error = std::move(*error_);
-      error_.reset();
-      return error;
+    const TypedStatus<T>& error() const& {
+      CHECK(!has_value_);
+      return error_;
+    }
+
+    TypedStatus<T>&& error() && {
+      CHECK(!has_value_);
+      return std::move(error_);
+    }
+
+    const OtherType& value() const& {
+      CHECK(has_value_);
+      return value_;
+    }
+
+    OtherType& value() & {
+      CHECK(has_value_);
+      return value_;
     }
 
-    OtherType value() && {
-      CHECK(value_);
-      auto value = std::move(*value_);
-      value_.reset();
-      return value;
+    OtherType&& value() && {
+      CHECK(has_value_);
+      return std::move(value_);
     }
 
     typename T::Codes code() const {
-      CHECK(
-          error_ ||
-          (value_ && internal::StatusTraitsHelper<Traits>::DefaultEnumValue()));
-      return error_ ? error_->code()
-                    : *internal::StatusTraitsHelper<Traits>::DefaultEnumValue();
+      CHECK(!has_value_ ||
+            internal::StatusTraitsHelper<Traits>::DefaultEnumValue());
+      return has_value_
+                 ? *internal::StatusTraitsHelper<Traits>::DefaultEnumValue()
+                 : error_.code();
     }
 
    private:
-    std::optional<TypedStatus<T>> error_;
-    std::optional<OtherType> value_;
+    void Destroy() {
+      if (has_value_)
+        value_.~OtherType();
+      else
+        error_.~TypedStatus<T>();
+    }
+
+    union {
+      TypedStatus<T> error_;
+      OtherType value_;
+    };
+    bool has_value_;
   };
 
- public:
-  std::unique_ptr<internal::StatusData> data_;
+ private:
+  void AddLocation(const Location& location) {
+    if (frame_count_ < kInlineFrames) {
+      frames_[frame_count_++] = location;
+      return;
+    }
+    data_.Mutable()->frames.push_back(location);
+    frame_count_++;
+  }
+
+  bool is_error_ = false;
+  StatusCodeType code_ = 0;
+  uint16_t frame_count_ = 0;
+  Location frames_[kInlineFrames];
+  internal::StatusDataRef data_;
 
   template <typename StatusEnum>
   friend class TypedStatus;
@@ -0,0 +1,172 @@
+// Measures what constructing, propagating and dropping TypedStatus errors
+// costs, in time and heap allocations per operation.
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include "base/benchmark.h"
+#include "base/status/status.h"
+#include "base/status/status_macros.h"
+#include "base/status/status_metrics.h"
+
+namespace {
+
+struct ParseTraits {
+  enum class Codes : base::StatusCodeType {
+    kOk = 0,
+    kMissingKey = 1,
+    kBadValue = 2,
+  };
+  static constexpr base::StatusGroupType Group() { return "ParseStatus"; }
+  static constexpr Codes DefaultEnumValue() { return Codes::kOk; }
+};
+
+using ParseStatus = base::TypedStatus<ParseTraits>;
+using Codes = ParseTraits::Codes;
+
+__attribute__((noinline)) ParseStatus Fail(int depth) {
+  if (!depth)
+    return ParseStatus(Codes::kMissingKey);
+  return Fail(depth - 1).AddHere();
+}
+
+__attribute__((noinline)) ParseStatus::Or<int> Lookup(int key) {
+  if (key % 4)
+    return Codes::kMissingKey;
+  return key;
+}
+
+// Three levels of parsing that fail at the bottom once in 100 inputs, with
+// errors propagated by the macros and, for comparison, by an exception like
+// the TraceException argparse.h throws.
+__attribute__((noinline)) ParseStatus CheckRange(int input) {
+  if (input < 0)
+    return Codes::kBadValue;
+  return Codes::kOk;
+}
+
+__attribute__((noinline)) ParseStatus::Or<int> ParseDigit(int input) {
+  if (input % 100 == 99)
+    return Codes::kBadValue;
+  return input % 10;
+}
+
+__attribute__((noinline)) ParseStatus::Or<int> ParseField(int input) {
+  ASSIGN_OR_RETURN(int digit, ParseDigit(input));
+  return digit * 2;
+}
+
+__attribute__((noinline)) ParseStatus::Or<int> ParseRecord(int input) {
+  RETURN_IF_ERROR(CheckRange(input));
+  ASSIGN_OR_RETURN(int field, ParseField(input));
+  return field + 1;
+}
+
+struct ParseError {
+  Codes code;
+};
+
+__attribute__((noinline)) void CheckRangeOrThrow(int input) {
+  if (input < 0)
+    throw ParseError{Codes::kBadValue};
+}
+
+__attribute__((noinline)) int ParseDigitOrThrow(int input) {
+  if (input % 100 == 99)
+    throw ParseError{Codes::kBadValue};
+  return input % 10;
+}
+
+__attribute__((noinline)) int ParseFieldOrThrow(int input) {
+  return ParseDigitOrThrow(input) * 2;
+}
+
+__attribute__((noinline)) int ParseRecordOrThrow(int input) {
+  CheckRangeOrThrow(input);
+  return ParseFieldOrThrow(input) + 1;
+}
+
+}  // namespace
+
+int main() {
+  printf("sizeof(ParseStatus) %zu, sizeof(ParseStatus::Or<int>) %zu\n",
+         sizeof(ParseStatus), sizeof(ParseStatus::Or<int>));
+  base::RunBenchmark("ok status", [](int) {
+    ParseStatus status(Codes::kOk);
+    base::DoNotOptimize(status);
+  });
+  base::RunBenchmark("error, code only", [](int) {
+    ParseStatus status(Codes::kMissingKey);
+    base::DoNotOptimize(status);
+  });
+  base::StatusMetrics::Enable();
+  base::RunBenchmark("error, code only, with metrics", [](int) {
+    ParseStatus status(Codes::kMissingKey);
+    base::DoNotOptimize(status);
+  });
+  base::StatusMetrics::Disable();
+  base::RunBenchmark("error with message", [](int) {
+    ParseStatus status(Codes::kBadValue, "expected an integer");
+    base::DoNotOptimize(status);
+  });
+  base::RunBenchmark("error, concatenated message", [](int i) {
+    ParseStatus status(Codes::kMissingKey,
+                       "no key \"" + std::string("optional_setting") +
+                           "\" at offset " + std::to_string(i));
+    base::DoNotOptimize(status);
+  });
+  base::RunBenchmark("error, formatted message", [](int i) {
+    ParseStatus status = ParseStatus::Format(
+        Codes::kMissingKey, "no key \"{}\" at offset {}",
+        std::string_view("optional_setting"), i);
+    base::DoNotOptimize(status);
+  });
+  base::RunBenchmark("error through 4 AddHere()", [](int) {
+    ParseStatus status = Fail(4);
+    base::DoNotOptimize(status);
+  });
+  base::RunBenchmark("copied error", [](int) {
+    static const ParseStatus original = Fail(2);
+    ParseStatus copy = original;
+    base::DoNotOptimize(copy);
+  });
+  base::RunBenchmark("copied error with message", [](int) {
+    static const ParseStatus original =
+        ParseStatus(Codes::kBadValue, "expected an integer").AddHere();
+    ParseStatus copy = original;
+    base::DoNotOptimize(copy);
+  });
+  base::RunBenchmark("Or<int> probe, 3 in 4 missing", [](int i) {
+    ParseStatus::Or<int> result = Lookup(i);
+    base::DoNotOptimize(result);
+  });
+  base::RunBenchmark("Or<int> value", [](int i) {
+    int value = Lookup(i * 4).value();
+    base::DoNotOptimize(value);
+  });
+  base::RunBenchmark("ASSIGN_OR_RETURN, no errors", [](int i) {
+    ParseStatus::Or<int> result = ParseRecord(i % 50);
+    base::DoNotOptimize(result);
+  });
+  base::RunBenchmark("ASSIGN_OR_RETURN, 1 in 100 fail", [](int i) {
+    ParseStatus::Or<int> result = ParseRecord(i);
+    base::DoNotOptimize(result);
+  });
+  base::RunBenchmark("exceptions, no errors", [](int i) {
+    try {
+      base::DoNotOptimize(ParseRecordOrThrow(i % 50));
+    } catch (const ParseError& error) {
+      base::DoNotOptimize(error.code);
+    }
+  });
+  base::RunBenchmark("exceptions, 1 in 100 fail", [](int i) {
+    try {
+      base::DoNotOptimize(ParseRecordOrThrow(i));
+    } catch (const ParseError& error) {
+      base::DoNotOptimize(error.code);
+    }
+  });
+  return 0;
+}
@@ -0,0 +1,63 @@
+#ifndef BASE_STATUS_STATUS_MACROS_H_
+#define BASE_STATUS_STATUS_MACROS_H_
+
+#include <utility>
+
+#include "base/location.h"
+#include "base/status/status.h"
+
+// Returns from the enclosing function if |expr|, a TypedStatus, is an error,
+// passing it on with the caller's location added. The function must return
+// the same TypedStatus or an Or of it.
+//
+//   RETURN_IF_ERROR(ReadHeader(file));
+#define RETURN_IF_ERROR(expr)    \
+  STATUS_MACROS_RETURN_IF_ERROR( \
+      STATUS_MACROS_CONCAT(_status_, __COUNTER__), expr)
+
+#define STATUS_MACROS_RETURN_IF_ERROR(status, expr)              \
+  do {                                                           \
+    auto status = (expr);                                        \
+    if (__builtin_expect(status.has_error(), 0)) {               \
+      return ::base::internal::PropagateError(                   \
+          std::move(status), ::base::Location::Site::Current()); \
+    }                                                            \
+  } while (0)
+
+// Assigns the value of |expr|, a TypedStatus::Or, to |lhs|, which may be a
+// declaration, or returns its error as RETURN_IF_ERROR() does.
+//
+//   ASSIGN_OR_RETURN(int width, ParseInt(args[1]));
+#define ASSIGN_OR_RETURN(lhs, expr) \
+  STATUS_MACROS_ASSIGN_OR_RETURN(   \
+      STATUS_MACROS_CONCAT(_status_or_, __COUNTER__), lhs, expr)
+
+#define STATUS_MACROS_ASSIGN_OR_RETURN(result, lhs, expr)              \
+  auto result = (expr);                                                \
+  if (__builtin_expect(result.has_error(), 0)) {                       \
+    return ::base::internal::PropagateError(                           \
+        std::move(result).error(), ::base::Location::Site::Current()); \
+  }                                                                    \
+  lhs = std::move(result).value()
+
+// Names the macros' temporaries uniquely, even for several uses on one line or
+// in one expansion of another macro.
+#define STATUS_MACROS_CONCAT(a, b) STATUS_MACROS_CONCAT_INNER(a, b)
+#define STATUS_MACROS_CONCAT_INNER(a, b) a##b
+
+namespace base {
+namespace internal {
+
+// The error path of the macros, kept out of line and out of the way of the
+// code around them.
+template <typename T>
+__attribute__((cold, noinline)) TypedStatus<T> PropagateError(
+    TypedStatus<T>&& status,
+    const Location::Site& site) {
+  return std::move(status).AddHere(site);
+}
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_STATUS_STATUS_MACROS_H_
@@ -0,0 +1,53 @@
+#include "base/status/status_metrics.h"
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace base {
+
+// static
+void StatusMetrics::Enable() {
+  internal::status_metrics_enabled.store(true, std::memory_order_relaxed);
+}
+
+// static
+void StatusMetrics::Disable() {
+  internal::status_metrics_enabled.store(false, std::memory_order_relaxed);
+}
+
+// static
+bool StatusMetrics::IsEnabled() {
+  return internal::status_metrics_enabled.load(std::memory_order_relaxed);
+}
+
+// static
+uint64_t StatusMetrics::Count(StatusGroupType group, StatusCodeType code) {
+  uint64_t uncounted;
+  for (const internal::StatusCount& count :
+       internal::CollectStatusCounts(&uncounted)) {
+    if (count.group == group && count.code == code)
+      return count.count;
+  }
+  return 0;
+}
+
+// static
+json::Object StatusMetrics::Dump() {
+  uint64_t uncounted;
+  std::map<std::string, json::Object::MapType> groups;
+  for (const internal::StatusCount& count :
+       internal::CollectStatusCounts(&uncounted)) {
+    groups[std::string(count.group)].insert(
+        {std::to_string(count.code), static_cast<json::Number>(count.count)});
+  }
+  json::Object::MapType dump;
+  for (auto& [group, codes] : groups)
+    dump.insert({group, json::Object(std::move(codes))});
+  if (uncounted)
+    dump.insert({"uncounted", static_cast<json::Number>(uncounted)});
+  return json::Object(std::move(dump));
+}
+
+}  // namespace base
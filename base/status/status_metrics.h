@@ -0,0 +1,32 @@
+#ifndef BASE_STATUS_STATUS_METRICS_H_
+#define BASE_STATUS_STATUS_METRICS_H_
+
+#include <cstdint>
+
+#include "base/json/json.h"
+#include "base/status/status.h"
+
+namespace base {
+
+// Counts how many errors of each TypedStatus group and code are created, so
+// that the hot error paths can be found in production without logging. Off
+// until enabled; while on, each error costs an uncontended increment of a
+// per-thread counter. Statuses that aren't errors are never counted.
+class StatusMetrics {
+ public:
+  static void Enable();
+  // Stops counting, keeping the counts so far.
+  static void Disable();
+  static bool IsEnabled();
+
+  // Errors with |code| in |group| created so far, on every thread.
+  static uint64_t Count(StatusGroupType group, StatusCodeType code);
+
+  // {group: {code: count}}, codes as decimal strings. Errors that didn't fit
+  // in their thread's table are summed under "uncounted".
+  static json::Object Dump();
+};
+
+}  // namespace base
+
+#endif  // BASE_STATUS_STATUS_METRICS_H_
@@ -0,0 +1,406 @@
+#include "base/status/status.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "base/status/status_macros.h"
+#include "base/status/status_metrics.h"
+#include "gtest/gtest.h"
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+
+namespace base {
+namespace {
+
+struct ParseTraits {
+  enum class Codes : StatusCodeType {
+    kOk = 0,
+    kMissingKey = 1,
+    kBadValue = 2,
+  };
+  static constexpr StatusGroupType Group() { return "ParseStatus"; }
+  static constexpr Codes DefaultEnumValue() { return Codes::kOk; }
+};
+
+using ParseStatus = TypedStatus<ParseTraits>;
+using Codes = ParseTraits::Codes;
+
+// Counts the instances alive, to catch values that Or leaks or destroys
+// twice.
+struct Counted {
+  static inline int alive = 0;
+
+  explicit Counted(int value) : value(value) { alive++; }
+  Counted(const Counted& other) : value(other.value) { alive++; }
+  Counted(Counted&& other) : value(std::exchange(other.value, -1)) {
+    alive++;
+  }
+  ~Counted() { alive--; }
+
+  int value;
+};
+
+ParseStatus Fail(int depth) {
+  if (!depth)
+    return ParseStatus(Codes::kMissingKey);
+  return Fail(depth - 1).AddHere();
+}
+
+TEST(TypedStatusTest, OkIsNotAnError) {
+  ParseStatus status(Codes::kOk);
+  EXPECT_FALSE(status.has_error());
+  EXPECT_EQ(status.code(), Codes::kOk);
+  EXPECT_EQ(status.frame_count(), 0u);
+}
+
+TEST(TypedStatusTest, ErrorKeepsCodeAndMessage) {
+  ParseStatus status(Codes::kBadValue, "expected an integer");
+  EXPECT_TRUE(status.has_error());
+  EXPECT_EQ(status.code(), Codes::kBadValue);
+  EXPECT_EQ(status.message(), "expected an integer");
+  EXPECT_EQ(status, ParseStatus(Codes::kBadValue));
+  EXPECT_NE(status, ParseStatus(Codes::kMissingKey));
+}
+
+TEST(TypedStatusTest, ErrorWithoutMessageHasAnEmptyOne) {
+  ParseStatus status(Codes::kMissingKey);
+  EXPECT_EQ(status.message(), "");
+}
+
+TEST(TypedStatusTest, RecordsWhereItWasCreated) {
+  int line = __LINE__ + 1;
+  ParseStatus status(Codes::kMissingKey);
+  ASSERT_EQ(status.frame_count(), 1u);
+  EXPECT_STREQ(status.frame(0).file_name(), __FILE__);
+  EXPECT_EQ(status.frame(0).line_number(), line);
+}
+
+TEST(TypedStatusTest, AddHereAppendsFrames) {
+  ParseStatus status = Fail(2);
+  ASSERT_EQ(status.frame_count(), 3u);
+  EXPECT_NE(status.frame(0), status.frame(1));
+  // Both AddHere()s are on the same line.
+  EXPECT_EQ(status.frame(1), status.frame(2));
+}
+
+TEST(TypedStatusTest, FramesBeyondInlineOnesSpillToTheHeap) {
+  constexpr size_t kDepth = ParseStatus::kInlineFrames * 2;
+  ParseStatus status = Fail(kDepth);
+  ASSERT_EQ(status.frame_count(), kDepth + 1);
+  for (size_t i = 1; i < status.frame_count(); i++)
+    EXPECT_EQ(status.frame(i), status.frame(1));
+  EXPECT_EQ(status.message(), "");
+}
+
+TEST(TypedStatusTest, CopiesShareTheMessage) {
+  ParseStatus status(Codes::kBadValue, "expected an integer");
+  ParseStatus copy = status;
+  EXPECT_EQ(&copy.message(), &status.message());
+  ParseStatus assigned(Codes::kMissingKey);
+  assigned = copy;
+  EXPECT_EQ(&assigned.message(), &status.message());
+  EXPECT_EQ(assigned.code(), Codes::kBadValue);
+}
+
+TEST(TypedStatusTest, CopiesOutliveTheOriginal) {
+  auto status =
+      std::make_unique<ParseStatus>(Codes::kBadValue, "expected an integer");
+  ParseStatus copy = *status;
+  status.reset();
+  EXPECT_EQ(copy.message(), "expected an integer");
+}
+
+TEST(TypedStatusTest, MovesTakeTheMessage) {
+  ParseStatus status(Codes::kBadValue, "expected an integer");
+  const std::string* message = &status.message();
+  ParseStatus moved = std::move(status);
+  EXPECT_EQ(&moved.message(), message);
+}
+
+TEST(TypedStatusTest, AddingFramesToACopyLeavesTheOriginal) {
+  ParseStatus status = Fail(ParseStatus::kInlineFrames);
+  size_t frames = status.frame_count();
+  ParseStatus copy = status;
+  copy = std::move(copy).AddHere();
+  EXPECT_EQ(copy.frame_count(), frames + 1);
+  EXPECT_EQ(status.frame_count(), frames);
+  EXPECT_EQ(copy.frame(frames - 1), status.frame(frames - 1));
+}
+
+TEST(TypedStatusTest, CopiesAcrossThreads) {
+  ParseStatus status(Codes::kBadValue, "expected an integer");
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([status]() {
+      for (int j = 0; j < 10000; j++) {
+        ParseStatus copy = status;
+        EXPECT_EQ(copy.code(), Codes::kBadValue);
+      }
+    });
+  }
+  for (std::thread& thread : threads)
+    thread.join();
+  EXPECT_EQ(status.message(), "expected an integer");
+}
+
+TEST(TypedStatusFormatTest, RendersEachKindOfArgument) {
+  enum Color { kRed, kGreen };
+  ParseStatus status = ParseStatus::Format(
+      Codes::kBadValue, "{} {} {} {} {} {}", -3, 4u, 2.5, true, 'x', kGreen);
+  EXPECT_EQ(status.message(), "-3 4 2.5 true x 1");
+}
+
+TEST(TypedStatusFormatTest, CopiesStrings) {
+  std::string key = "width";
+  char buffer[] = "height";
+  ParseStatus status = ParseStatus::Format(
+      Codes::kMissingKey, "{} {} {} {}", key, std::string_view("depth"),
+      buffer, "literal");
+  key = "changed";
+  buffer[0] = 'X';
+  EXPECT_EQ(status.message(), "width depth height literal");
+}
+
+TEST(TypedStatusFormatTest, RendersNullStrings) {
+  const char* null_string = nullptr;
+  char* null_buffer = nullptr;
+  ParseStatus status = ParseStatus::Format(Codes::kMissingKey, "{} {}",
+                                           null_string, null_buffer);
+  EXPECT_EQ(status.message(), "(null) (null)");
+}
+
+TEST(TypedStatusFormatTest, TruncatesStringsPastTheLimit) {
+  constexpr size_t kLimit = internal::StatusData::kMaxFormatStringBytes;
+  std::string long_string(kLimit + 10, 'a');
+  ParseStatus status =
+      ParseStatus::Format(Codes::kBadValue, "{}.{}", long_string, "b");
+  EXPECT_EQ(status.message(), std::string(kLimit, 'a') + ".");
+}
+
+TEST(TypedStatusFormatTest, LeavesUnmatchedPlaceholders) {
+  ParseStatus status =
+      ParseStatus::Format(Codes::kBadValue, "{} of {} at {", 1);
+  EXPECT_EQ(status.message(), "1 of {} at {");
+}
+
+TEST(TypedStatusFormatTest, RendersOnceForEveryCopy) {
+  ParseStatus status = ParseStatus::Format(Codes::kBadValue, "{}", 42);
+  ParseStatus copy = status;
+  const std::string& message = copy.message();
+  EXPECT_EQ(message, "42");
+  EXPECT_EQ(&status.message(), &message);
+}
+
+TEST(TypedStatusFormatTest, RecordsTheCaller) {
+  int line = __LINE__ + 1;
+  ParseStatus status = ParseStatus::Format(Codes::kBadValue, "{}", 1);
+  ASSERT_EQ(status.frame_count(), 1u);
+  EXPECT_EQ(status.frame(0).line_number(), line);
+}
+
+TEST(TypedStatusOrTest, HoldsAValue) {
+  ParseStatus::Or<int> result = 5;
+  EXPECT_TRUE(result.has_value());
+  EXPECT_FALSE(result.has_error());
+  EXPECT_EQ(result.value(), 5);
+  EXPECT_EQ(result.code(), Codes::kOk);
+}
+
+TEST(TypedStatusOrTest, HoldsAnError) {
+  ParseStatus::Or<int> result = Codes::kMissingKey;
+  EXPECT_TRUE(result.has_error());
+  EXPECT_EQ(result.code(), Codes::kMissingKey);
+  EXPECT_EQ(result.error().frame_count(), 1u);
+
+  ParseStatus::Or<int> from_status = ParseStatus(Codes::kBadValue, "bad");
+  EXPECT_EQ(from_status.error().message(), "bad");
+}
+
+TEST(TypedStatusOrTest, SharesStorageBetweenValueAndError) {
+  EXPECT_LE(sizeof(ParseStatus::Or<int>),
+            sizeof(ParseStatus) + alignof(ParseStatus));
+  EXPECT_LE(sizeof(ParseStatus::Or<std::string>),
+            std::max(sizeof(ParseStatus), sizeof(std::string)) +
+                alignof(ParseStatus));
+}
+
+TEST(TypedStatusOrTest, MovesOutMoveOnlyValues) {
+  ParseStatus::Or<std::unique_ptr<int>> result = std::make_unique<int>(7);
+  std::unique_ptr<int> value = std::move(result).value();
+  ASSERT_TRUE(value);
+  EXPECT_EQ(*value, 7);
+}
+
+TEST(TypedStatusOrTest, MovesOutErrors) {
+  ParseStatus::Or<int> result = ParseStatus(Codes::kBadValue, "bad");
+  ParseStatus error = std::move(result).error();
+  EXPECT_EQ(error.code(), Codes::kBadValue);
+  EXPECT_EQ(error.message(), "bad");
+}
+
+TEST(TypedStatusOrTest, DestroysWhicheverItHolds) {
+  {
+    ParseStatus::Or<Counted> value = Counted(1);
+    ParseStatus::Or<Counted> error = Codes::kMissingKey;
+    EXPECT_EQ(Counted::alive, 1);
+
+    ParseStatus::Or<Counted> moved = std::move(value);
+    EXPECT_EQ(moved.value().value, 1);
+    EXPECT_EQ(Counted::alive, 2);
+
+    // Value over error, then error over value.
+    error = std::move(moved);
+    EXPECT_EQ(error.value().value, 1);
+    moved = ParseStatus::Or<Counted>(Codes::kBadValue);
+    EXPECT_EQ(moved.code(), Codes::kBadValue);
+    EXPECT_EQ(Counted::alive, 2);
+  }
+  EXPECT_EQ(Counted::alive, 0);
+}
+
+TEST(TypedStatusOrDeathTest, RejectsTheOkCode) {
+  EXPECT_DEATH(ParseStatus::Or<int>{Codes::kOk}, "");
+}
+
+ParseStatus::Or<int> ParseDigit(char c) {
+  if (c < '0' || c > '9')
+    return ParseStatus::Format(Codes::kBadValue, "not a digit: {}", c);
+  return c - '0';
+}
+
+ParseStatus CheckDigit(char c) {
+  if (c < '0' || c > '9')
+    return Codes::kBadValue;
+  return Codes::kOk;
+}
+
+ParseStatus::Or<int> ParseTwoDigits(const char* text) {
+  RETURN_IF_ERROR(CheckDigit(text[0]));
+  ASSIGN_OR_RETURN(int tens, ParseDigit(text[0]));
+  int ones = 0;
+  ASSIGN_OR_RETURN(ones, ParseDigit(text[1]));
+  return tens * 10 + ones;
+}
+
+ParseStatus CheckBoth(char a, char b) {
+  // Two uses on one line need distinct temporaries.
+  RETURN_IF_ERROR(CheckDigit(a)); RETURN_IF_ERROR(CheckDigit(b));
+  return Codes::kOk;
+}
+
+ParseStatus::Or<std::unique_ptr<int>> MakeBox(int value) {
+  if (value < 0)
+    return Codes::kBadValue;
+  return std::make_unique<int>(value);
+}
+
+ParseStatus::Or<int> Unbox(int value) {
+  ASSIGN_OR_RETURN(std::unique_ptr<int> box, MakeBox(value));
+  return *box;
+}
+
+TEST(StatusMacrosTest, PassValuesThrough) {
+  ParseStatus::Or<int> result = ParseTwoDigits("42");
+  ASSERT_TRUE(result.has_value());
+  EXPECT_EQ(result.value(), 42);
+  EXPECT_FALSE(CheckBoth('1', '2').has_error());
+  EXPECT_EQ(Unbox(3).value(), 3);
+}
+
+TEST(StatusMacrosTest, ReturnIfErrorAddsTheCallersFrame) {
+  ParseStatus::Or<int> result = ParseTwoDigits("x2");
+  ASSERT_TRUE(result.has_error());
+  EXPECT_EQ(result.code(), Codes::kBadValue);
+  ASSERT_EQ(result.error().frame_count(), 2u);
+  EXPECT_NE(result.error().frame(0), result.error().frame(1));
+}
+
+TEST(StatusMacrosTest, AssignOrReturnKeepsTheError) {
+  ParseStatus::Or<int> result = ParseTwoDigits("4y");
+  ASSERT_TRUE(result.has_error());
+  EXPECT_EQ(result.error().message(), "not a digit: y");
+  EXPECT_EQ(result.error().frame_count(), 2u);
+  EXPECT_EQ(Unbox(-1).code(), Codes::kBadValue);
+}
+
+TEST(StatusMacrosTest, SeveralUsesOnOneLine) {
+  EXPECT_EQ(CheckBoth('1', 'b').code(), Codes::kBadValue);
+  EXPECT_EQ(CheckBoth('a', '2').code(), Codes::kBadValue);
+}
+
+// A group of its own, so that no other test's errors are counted.
+struct MetricsTraits {
+  enum class Codes : StatusCodeType { kOk = 0, kFailed = 1, kTimedOut = 2 };
+  static constexpr StatusGroupType Group() { return "MetricsStatus"; }
+  static constexpr Codes DefaultEnumValue() { return Codes::kOk; }
+};
+
+using MetricsStatus = TypedStatus<MetricsTraits>;
+
+uint64_t MetricsCount(MetricsTraits::Codes code) {
+  return StatusMetrics::Count(MetricsTraits::Group(),
+                              static_cast<StatusCodeType>(code));
+}
+
+TEST(StatusMetricsTest, CountsErrorsOnlyWhileEnabled) {
+  uint64_t before = MetricsCount(MetricsTraits::Codes::kFailed);
+  MetricsStatus uncounted(MetricsTraits::Codes::kFailed);
+  EXPECT_EQ(MetricsCount(MetricsTraits::Codes::kFailed), before);
+
+  StatusMetrics::Enable();
+  EXPECT_TRUE(StatusMetrics::IsEnabled());
+  for (int i = 0; i < 3; i++)
+    MetricsStatus status(MetricsTraits::Codes::kFailed);
+  MetricsStatus ok(MetricsTraits::Codes::kOk);
+  MetricsStatus::Or<int> value = 1;
+  StatusMetrics::Disable();
+  MetricsStatus after_disable(MetricsTraits::Codes::kFailed);
+
+  EXPECT_FALSE(StatusMetrics::IsEnabled());
+  EXPECT_EQ(MetricsCount(MetricsTraits::Codes::kFailed), before + 3);
+  EXPECT_EQ(MetricsCount(MetricsTraits::Codes::kOk), 0u);
+}
+
+TEST(StatusMetricsTest, SumsThreads) {
+  uint64_t before = MetricsCount(MetricsTraits::Codes::kTimedOut);
+  StatusMetrics::Enable();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([]() {
+      for (int j = 0; j < 1000; j++)
+        MetricsStatus status(MetricsTraits::Codes::kTimedOut);
+    });
+  }
+  for (std::thread& thread : threads)
+    thread.join();
+  StatusMetrics::Disable();
+  EXPECT_EQ(MetricsCount(MetricsTraits::Codes::kTimedOut), before + 4000);
+}
+
+TEST(StatusMetricsTest, DumpsCountsByGroupAndCode) {
+  StatusMetrics::Enable();
+  MetricsStatus status(MetricsTraits::Codes::kFailed);
+  StatusMetrics::Disable();
+  json::Object dump = StatusMetrics::Dump();
+  std::optional<json::Object> group =
+      json::Unpack<json::Object>(dump["MetricsStatus"]);
+  ASSERT_TRUE(group);
+  std::optional<json::Number> count =
+      json::Unpack<json::Number>((*group)["1"]);
+  ASSERT_TRUE(count);
+  EXPECT_EQ(static_cast<uint64_t>(*count),
+            MetricsCount(MetricsTraits::Codes::kFailed));
+}
+
+}  // namespace
+}  // namespace base
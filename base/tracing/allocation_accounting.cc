@@ -0,0 +1,16 @@
+#include "base/tracing/allocation_accounting.h"
+
+#include <map>
+#include <string>
+
+namespace base {
+
+json::Object AllocationStats::ToJson() const {
+  std::map<std::string, json::JSON> values;
+  values.insert({"events", static_cast<ssize_t>(events)});
+  values.insert({"allocations", static_cast<ssize_t>(allocations)});
+  values.insert({"bytes", static_cast<ssize_t>(bytes)});
+  return json::Object(std::move(values));
+}
+
+}  // namespace base
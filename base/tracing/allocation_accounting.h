@@ -0,0 +1,68 @@
+#ifndef BASE_TRACING_ALLOCATION_ACCOUNTING_H_
+#define BASE_TRACING_ALLOCATION_ACCOUNTING_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "base/json/json.h"
+
+namespace base {
+
+// What the TRACE_EVENTs of one name allocated, summed over every thread. Only
+// allocations made directly in a scope count towards it, not those of the
+// TRACE_EVENTs nested inside.
+struct AllocationStats {
+  uint64_t events = 0;
+  uint64_t allocations = 0;
+  uint64_t bytes = 0;
+
+  // {"events", "allocations", "bytes"}.
+  json::Object ToJson() const;
+};
+
+namespace internal {
+
+// Calls to operator new on this thread since the innermost TRACE_EVENT that
+// records allocations began, not counting those of the events inside it.
+// Bumped by the replacement operator new in allocation_hooks.cc.
+struct ThreadAllocationCounters {
+  uint64_t count;
+  uint64_t bytes;
+};
+
+inline thread_local ThreadAllocationCounters thread_allocations = {};
+
+// Set by allocation_hooks.cc when it is linked in.
+inline bool allocation_hooks_linked = false;
+
+// The per-thread half of AllocationStats. Only the owning thread records.
+class ThreadAllocationStats {
+ public:
+  // |weight| is the number of events a sampled one stands for.
+  void Record(const ThreadAllocationCounters& counters, uint64_t weight) {
+    Increment(events_, weight);
+    Increment(allocations_, counters.count * weight);
+    Increment(bytes_, counters.bytes * weight);
+  }
+
+  void MergeInto(AllocationStats* stats) const {
+    stats->events += events_.load(std::memory_order_relaxed);
+    stats->allocations += allocations_.load(std::memory_order_relaxed);
+    stats->bytes += bytes_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  static void Increment(std::atomic<uint64_t>& counter, uint64_t by) {
+    counter.store(counter.load(std::memory_order_relaxed) + by,
+                  std::memory_order_relaxed);
+  }
+
+  std::atomic<uint64_t> events_ = 0;
+  std::atomic<uint64_t> allocations_ = 0;
+  std::atomic<uint64_t> bytes_ = 0;
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_TRACING_ALLOCATION_ACCOUNTING_H_
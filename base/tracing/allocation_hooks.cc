@@ -0,0 +1,126 @@
+// Replaces the global operator new and delete so that TRACE_EVENTs can count
+// the allocations made inside them. Only binaries that want this should
+// depend on //base/tracing:allocation_hooks, and then turn on
+// Tracer::kRecordAllocations.
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "base/tracing/allocation_accounting.h"
+
+namespace {
+
+[[maybe_unused]] const bool g_linked = [] {
+  base::internal::allocation_hooks_linked = true;
+  return true;
+}();
+
+void* Allocate(std::size_t size, std::size_t alignment) {
+  base::internal::ThreadAllocationCounters& counters =
+      base::internal::thread_allocations;
+  counters.count++;
+  counters.bytes += size;
+  if (!size)
+    size = 1;
+  while (true) {
+    void* result = nullptr;
+    if (alignment <= alignof(std::max_align_t))
+      result = malloc(size);
+    else if (posix_memalign(&result, alignment, size))
+      result = nullptr;
+    if (result)
+      return result;
+    std::new_handler handler = std::get_new_handler();
+    if (!handler)
+      return nullptr;
+    handler();
+  }
+}
+
+void* AllocateOrThrow(std::size_t size, std::size_t alignment) {
+  void* result = Allocate(size, alignment);
+  if (!result)
+    throw std::bad_alloc();
+  return result;
+}
+
+constexpr std::size_t kDefaultAlignment = alignof(std::max_align_t);
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  return AllocateOrThrow(size, kDefaultAlignment);
+}
+
+void* operator new[](std::size_t size) {
+  return AllocateOrThrow(size, kDefaultAlignment);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return Allocate(size, kDefaultAlignment);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return Allocate(size, kDefaultAlignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  return AllocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+  return AllocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new(std::size_t size,
+                   std::align_val_t alignment,
+                   const std::nothrow_t&) noexcept {
+  return Allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size,
+                     std::align_val_t alignment,
+                     const std::nothrow_t&) noexcept {
+  return Allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* pointer) noexcept {
+  free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+  free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+  free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+  free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+  free(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+  free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept {
+  free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept {
+  free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+  free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+  free(pointer);
+}
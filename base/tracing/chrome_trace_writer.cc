@@ -0,0 +1,199 @@
+#include "base/tracing/chrome_trace_writer.h"
+
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+
+#include "base/json/json_io.h"
+
+namespace base {
+namespace internal {
+
+void WriteJsonString(std::ostream& out, std::string_view value) {
+  out.put('"');
+  bool plain = true;
+  for (char c : value)
+    plain &= c != '"' && c != '\\' && static_cast<unsigned char>(c) >= 0x20;
+  if (plain) {
+    out.write(value.data(), value.size());
+    out.put('"');
+    return;
+  }
+  for (char c : value) {
+    switch (c) {
+      case '"':
+        out << "\\\"";
+        break;
+      case '\\':
+        out << "\\\\";
+        break;
+      case '\n':
+        out << "\\n";
+        break;
+      case '\t':
+        out << "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char escaped[8];
+          snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+          out << escaped;
+        } else {
+          out << c;
+        }
+    }
+  }
+  out << '"';
+}
+
+char ChromeTracePhase(uint32_t type) {
+  switch (type) {
+    case TraceRecord::kBegin:
+      return 'B';
+    case TraceRecord::kEnd:
+      return 'E';
+    case TraceRecord::kInstant:
+      return 'i';
+    case TraceRecord::kCounter:
+      return 'C';
+    case TraceRecord::kAsyncBegin:
+      return 'b';
+    case TraceRecord::kAsyncEnd:
+      return 'e';
+    case TraceRecord::kFlowBegin:
+      return 's';
+    case TraceRecord::kFlowEnd:
+      return 'f';
+  }
+  return 'n';
+}
+
+ChromeTraceWriter::ChromeTraceWriter(const Tracer* tracer, std::ostream& out)
+    : tracer_(tracer), out_(out), pid_(getpid()) {}
+
+void ChromeTraceWriter::WriteHeader() {
+  out_ << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+}
+
+void ChromeTraceWriter::StartEvent(std::string_view phase,
+                                   uint64_t thread_id) {
+  out_ << (first_event_ ? "\n" : ",\n");
+  first_event_ = false;
+  out_ << "{\"ph\":\"" << phase << "\",\"pid\":" << pid_
+       << ",\"tid\":" << thread_id;
+}
+
+void ChromeTraceWriter::WriteRecords(uint64_t thread_id,
+                                     const TraceSlot* slots,
+                                     size_t count) {
+  auto write = [this, thread_id](const TraceRecord& record,
+                                 const TraceSlot* extra) {
+    WriteRecord(thread_id, record, extra);
+  };
+  ForEachRecordIn(slots, count, write);
+}
+
+void ChromeTraceWriter::WriteRecord(uint64_t thread_id,
+                                    const TraceRecord& record,
+                                    const TraceSlot* extra) {
+  // Formatted by hand rather than through operator<<, which dominates the
+  // cost of exporting large traces.
+  char buffer[128];
+  int size = snprintf(
+      buffer, sizeof(buffer),
+      "%s{\"ph\":\"%c\",\"pid\":%d,\"tid\":%lu,\"ts\":%lu.%03lu,\"name\":",
+      first_event_ ? "\n" : ",\n", ChromeTracePhase(record.type), pid_,
+      static_cast<unsigned long>(thread_id),
+      static_cast<unsigned long>(record.timestamp / 1000),
+      static_cast<unsigned long>(record.timestamp % 1000));
+  first_event_ = false;
+  out_.write(buffer, size);
+  WriteJsonString(out_, tracer_->FrameName(record.frame));
+  if (record.type != TraceRecord::kEnd) {
+    out_ << ",\"cat\":";
+    WriteJsonString(out_, tracer_->FrameCategory(record.frame));
+  }
+  uint64_t payload = RecordPayload(record, extra);
+  switch (record.type) {
+    case TraceRecord::kBegin:
+    case TraceRecord::kEnd:
+      if (record.arg_types)
+        WriteArgs(record, extra);
+      break;
+    case TraceRecord::kInstant:
+      out_ << ",\"s\":\"t\"";
+      break;
+    case TraceRecord::kCounter:
+      out_ << ",\"args\":{\"value\":" << static_cast<int64_t>(payload) << "}";
+      break;
+    case TraceRecord::kFlowEnd:
+      out_ << ",\"bp\":\"e\"";
+      [[fallthrough]];
+    case TraceRecord::kAsyncBegin:
+    case TraceRecord::kAsyncEnd:
+    case TraceRecord::kFlowBegin:
+      size = snprintf(buffer, sizeof(buffer), ",\"id\":\"0x%lx\"",
+                      static_cast<unsigned long>(payload));
+      out_.write(buffer, size);
+      break;
+  }
+  out_.put('}');
+}
+
+void ChromeTraceWriter::WriteArgs(const TraceRecord& record,
+                                  const TraceSlot* extra) {
+  out_ << ",\"args\":{";
+  bool first = true;
+  ForEachTraceArg(record, extra, [this, &first](const TraceArg& arg,
+                                                TraceArg::Type type,
+                                                std::string_view string) {
+    if (!first)
+      out_.put(',');
+    first = false;
+    WriteJsonString(out_, arg.key);
+    out_.put(':');
+    switch (type) {
+      case TraceArg::kNone:
+        break;
+      case TraceArg::kInt:
+        out_ << arg.int_value;
+        break;
+      case TraceArg::kUint:
+        out_ << arg.uint_value;
+        break;
+      case TraceArg::kDouble:
+        if (std::isfinite(arg.double_value)) {
+          char buffer[32];
+          out_.write(buffer, snprintf(buffer, sizeof(buffer), "%.17g",
+                                      arg.double_value));
+        } else {
+          out_ << "null";
+        }
+        break;
+      case TraceArg::kBool:
+        out_ << (arg.bool_value ? "true" : "false");
+        break;
+      case TraceArg::kString:
+      case TraceArg::kCopiedString:
+        WriteJsonString(out_, string);
+        break;
+    }
+  });
+  out_.put('}');
+}
+
+void ChromeTraceWriter::WriteThreadName(uint64_t thread_id,
+                                        const std::string& name) {
+  StartEvent("M", thread_id);
+  out_ << ",\"name\":\"thread_name\",\"args\":{\"name\":";
+  WriteJsonString(out_, name);
+  out_ << "}}";
+}
+
+void ChromeTraceWriter::WriteFooter(const json::Object& other_data) {
+  out_ << "\n],\"otherData\":" << other_data << "}\n";
+}
+
+}  // namespace internal
+}  // namespace base
@@ -0,0 +1,52 @@
+#ifndef BASE_TRACING_CHROME_TRACE_WRITER_H_
+#define BASE_TRACING_CHROME_TRACE_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include "base/json/json.h"
+#include "base/tracing/trace.h"
+
+namespace base {
+namespace internal {
+
+// Writes trace records as Chrome trace-event JSON, one object per record, so
+// that a trace can be produced incrementally without holding it in memory.
+// Call WriteHeader() once, then any number of WriteRecords() and
+// WriteThreadName(), then WriteFooter().
+class ChromeTraceWriter {
+ public:
+  ChromeTraceWriter(const Tracer* tracer, std::ostream& out);
+
+  void WriteHeader();
+  void WriteRecords(uint64_t thread_id, const TraceSlot* slots, size_t count);
+  void WriteRecord(uint64_t thread_id,
+                   const TraceRecord& record,
+                   const TraceSlot* extra);
+  void WriteThreadName(uint64_t thread_id, const std::string& name);
+
+  // Closes the event array and stores |other_data| under "otherData".
+  void WriteFooter(const json::Object& other_data);
+
+ private:
+  void StartEvent(std::string_view phase, uint64_t thread_id);
+  void WriteArgs(const TraceRecord& record, const TraceSlot* extra);
+
+  const Tracer* tracer_;
+  std::ostream& out_;
+  const int pid_;
+  bool first_event_ = true;
+};
+
+void WriteJsonString(std::ostream& out, std::string_view value);
+
+// The trace-event "ph" for a TraceRecord::Type.
+char ChromeTracePhase(uint32_t type);
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_TRACING_CHROME_TRACE_WRITER_H_
@@ -0,0 +1,219 @@
+#include "base/tracing/flight_recorder.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <string_view>
+
+#include "base/check.h"
+#include "base/debug/crash_handler.h"
+#include "base/debug/signal_safe_writer.h"
+#include "base/tracing/chrome_trace_writer.h"
+
+namespace base {
+namespace internal {
+
+namespace {
+
+const Tracer* g_tracer = nullptr;
+char g_path[PATH_MAX];
+std::atomic<uint32_t> g_snapshot_count = 0;
+std::atomic<bool> g_crashing = false;
+
+// Where each chunk is copied before it's written out, so that one the owning
+// thread recycles meanwhile can be recognized and left out. Only one snapshot
+// is written at a time.
+TraceSlot g_scratch[TraceChunk::kCapacity];
+std::atomic<bool> g_writing = false;
+
+// Nanoseconds as the fractional microseconds trace-event JSON expects.
+void AppendMicros(SignalSafeWriter& out, uint64_t nanos) {
+  out.AppendUnsigned(nanos / 1000);
+  char fraction[4] = {'.', static_cast<char>('0' + nanos / 100 % 10),
+                      static_cast<char>('0' + nanos / 10 % 10),
+                      static_cast<char>('0' + nanos % 10)};
+  out.Append(fraction, sizeof(fraction));
+}
+
+void AppendJsonString(SignalSafeWriter& out, std::string_view str) {
+  out.Append("\"");
+  for (char c : str) {
+    if (c == '"' || c == '\\')
+      out.Append("\\", 1);
+    if (static_cast<unsigned char>(c) >= 0x20)
+      out.Append(&c, 1);
+  }
+  out.Append("\"");
+}
+
+void WriteArgs(SignalSafeWriter& out,
+               const TraceRecord& record,
+               const TraceSlot* extra) {
+  out.Append(",\"args\":{");
+  bool first = true;
+  ForEachTraceArg(record, extra, [&](const TraceArg& arg, TraceArg::Type type,
+                                     std::string_view string) {
+    if (!first)
+      out.Append(",");
+    first = false;
+    AppendJsonString(out, arg.key);
+    out.Append(":");
+    switch (type) {
+      case TraceArg::kNone:
+        break;
+      case TraceArg::kInt:
+        out.AppendSigned(arg.int_value);
+        break;
+      case TraceArg::kUint:
+        out.AppendUnsigned(arg.uint_value);
+        break;
+      case TraceArg::kDouble:
+        out.AppendDouble(arg.double_value);
+        break;
+      case TraceArg::kBool:
+        out.Append(arg.bool_value ? "true" : "false");
+        break;
+      case TraceArg::kString:
+      case TraceArg::kCopiedString:
+        AppendJsonString(out, string);
+        break;
+    }
+  });
+  out.Append("}");
+}
+
+void WriteThread(SignalSafeWriter& out,
+                 const ThreadTraceBuffer& buffer,
+                 uint64_t pid,
+                 bool& first) {
+  auto start_event = [&](const char* phase) {
+    out.Append(first ? "\n{\"ph\":\"" : ",\n{\"ph\":\"");
+    first = false;
+    out.Append(phase);
+    out.Append("\",\"pid\":");
+    out.AppendUnsigned(pid);
+    out.Append(",\"tid\":");
+    out.AppendUnsigned(buffer.thread_id());
+  };
+  // One extra chunk covers a walk that races with the owner recycling.
+  buffer.ForEachRecentRecord(
+      g_tracer->ring_chunks() + 1, g_scratch,
+      [&](const TraceRecord& record, const TraceSlot* extra) {
+        uint64_t payload = RecordPayload(record, extra);
+        char phase[2] = {ChromeTracePhase(record.type), '\0'};
+        start_event(phase);
+        out.Append(",\"ts\":");
+        AppendMicros(out, record.timestamp);
+        out.Append(",\"name\":");
+        AppendJsonString(out, g_tracer->FrameName(record.frame));
+        if (record.type != TraceRecord::kEnd) {
+          out.Append(",\"cat\":");
+          AppendJsonString(out, g_tracer->FrameCategory(record.frame));
+        }
+        if (record.type == TraceRecord::kInstant)
+          out.Append(",\"s\":\"t\"");
+        if (record.type == TraceRecord::kFlowEnd)
+          out.Append(",\"bp\":\"e\"");
+        if (record.type == TraceRecord::kCounter) {
+          out.Append(",\"args\":{\"value\":");
+          out.AppendSigned(static_cast<int64_t>(payload));
+          out.Append("}");
+        } else if (record.type > TraceRecord::kCounter) {
+          out.Append(",\"id\":\"0x");
+          out.AppendHex(payload);
+          out.Append("\"");
+        } else if (record.arg_types) {
+          WriteArgs(out, record, extra);
+        }
+        out.Append("}");
+      });
+  start_event("M");
+  out.Append(",\"name\":\"thread_name\",\"args\":{\"name\":");
+  AppendJsonString(out, buffer.thread_name());
+  out.Append("}}");
+}
+
+void OnSnapshotSignal(int) {
+  int saved_errno = errno;
+  FlightRecorder::WriteSnapshot();
+  errno = saved_errno;
+}
+
+// Runs on a crash, and on a failed CHECK, which then aborts; whichever comes
+// first takes the snapshot.
+void OnCrash() {
+  if (!g_crashing.exchange(true))
+    FlightRecorder::WriteSnapshot();
+}
+
+}  // namespace
+
+// static
+void FlightRecorder::Install(const Tracer* tracer, const std::string& path) {
+  g_tracer = tracer;
+  strncpy(g_path, path.c_str(), sizeof(g_path) - 48);
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  sigemptyset(&action.sa_mask);
+  action.sa_handler = &OnSnapshotSignal;
+  action.sa_flags = SA_RESTART;
+  sigaction(SIGUSR1, &action, nullptr);
+
+  InstallCrashHandler();
+  AddCrashCallback(&OnCrash);
+  SetCheckFailureHook(&OnCrash);
+}
+
+// static
+void FlightRecorder::WriteSnapshot() {
+  // A snapshot already being written, perhaps by the code this signal
+  // interrupted, has the scratch buffer.
+  if (!g_tracer || g_writing.exchange(true))
+    return;
+  // "<path>.<pid>.<n>", assembled by hand since snprintf may allocate.
+  char path[PATH_MAX];
+  size_t length = strlen(g_path);
+  memcpy(path, g_path, length);
+  auto append_number = [&path, &length](uint64_t n) {
+    char digits[20];
+    size_t count = 0;
+    do {
+      digits[count++] = static_cast<char>('0' + n % 10);
+      n /= 10;
+    } while (n);
+    path[length++] = '.';
+    while (count)
+      path[length++] = digits[--count];
+  };
+  append_number(static_cast<uint64_t>(getpid()));
+  append_number(g_snapshot_count.fetch_add(1));
+  path[length] = '\0';
+
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    g_writing.store(false);
+    return;
+  }
+  {
+    SignalSafeWriter out(fd);
+    out.Append("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    bool first = true;
+    uint64_t pid = static_cast<uint64_t>(getpid());
+    for (const ThreadTraceBuffer* buffer = g_tracer->registered_buffers();
+         buffer; buffer = buffer->next_registered()) {
+      WriteThread(out, *buffer, pid, first);
+    }
+    out.Append("\n]}\n");
+  }
+  close(fd);
+  g_writing.store(false);
+}
+
+}  // namespace internal
+}  // namespace base
@@ -0,0 +1,27 @@
+#ifndef BASE_TRACING_FLIGHT_RECORDER_H_
+#define BASE_TRACING_FLIGHT_RECORDER_H_
+
+#include <string>
+
+#include "base/tracing/trace.h"
+
+namespace base {
+namespace internal {
+
+// Writes snapshots of the Tracer's per-thread rings as Chrome trace-event
+// JSON. Everything reachable from WriteSnapshot() is async-signal-safe: it
+// neither allocates nor locks, and writes with write(2).
+class FlightRecorder {
+ public:
+  // Installs the SIGUSR1 handler, the crash handler with a callback that
+  // takes a snapshot, and the CHECK failure hook. Snapshots go to
+  // "<path>.<pid>.<n>".
+  static void Install(const Tracer* tracer, const std::string& path);
+
+  static void WriteSnapshot();
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_TRACING_FLIGHT_RECORDER_H_
@@ -0,0 +1,81 @@
+#include "base/tracing/latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+
+namespace base {
+
+// static
+uint64_t LatencyHistogram::BucketLowerBound(size_t bucket) {
+  size_t group = bucket / kSubBuckets;
+  uint64_t sub_bucket = bucket % kSubBuckets;
+  if (!group)
+    return sub_bucket;
+  return (kSubBuckets + sub_bucket) << (group - 1);
+}
+
+void LatencyHistogram::Record(uint64_t value) {
+  counts_[BucketFor(value)]++;
+  count_++;
+  sum_ += value;
+  min_ = std::min(min_, value);
+  max_ = std::max(max_, value);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+  for (size_t i = 0; i < kBuckets; i++)
+    counts_[i] += other.counts_[i];
+  count_ += other.count_;
+  sum_ += other.sum_;
+  min_ = std::min(min_, other.min_);
+  max_ = std::max(max_, other.max_);
+}
+
+uint64_t LatencyHistogram::Percentile(double percentile) const {
+  if (!count_)
+    return 0;
+  uint64_t rank = static_cast<uint64_t>(
+      std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * count_));
+  rank = std::max<uint64_t>(rank, 1);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets; i++) {
+    seen += counts_[i];
+    if (seen >= rank) {
+      if (i + 1 == kBuckets)
+        return max_;
+      return std::clamp(BucketLowerBound(i + 1) - 1, min_, max_);
+    }
+  }
+  return max_;
+}
+
+json::Object LatencyHistogram::ToJson() const {
+  std::map<std::string, json::JSON> values;
+  values.insert({"count", static_cast<ssize_t>(count())});
+  values.insert({"min", static_cast<ssize_t>(min())});
+  values.insert({"mean", static_cast<ssize_t>(mean())});
+  values.insert({"p50", static_cast<ssize_t>(Percentile(50))});
+  values.insert({"p90", static_cast<ssize_t>(Percentile(90))});
+  values.insert({"p99", static_cast<ssize_t>(Percentile(99))});
+  values.insert({"p999", static_cast<ssize_t>(Percentile(99.9))});
+  values.insert({"max", static_cast<ssize_t>(max())});
+  return json::Object(std::move(values));
+}
+
+namespace internal {
+
+void ThreadLatencyHistogram::MergeInto(LatencyHistogram* histogram) const {
+  for (size_t i = 0; i < LatencyHistogram::kBuckets; i++)
+    histogram->counts_[i] += counts_[i].load(std::memory_order_relaxed);
+  histogram->count_ += count_.load(std::memory_order_relaxed);
+  histogram->sum_ += sum_.load(std::memory_order_relaxed);
+  histogram->min_ =
+      std::min(histogram->min_, min_.load(std::memory_order_relaxed));
+  histogram->max_ =
+      std::max(histogram->max_, max_.load(std::memory_order_relaxed));
+}
+
+}  // namespace internal
+}  // namespace base
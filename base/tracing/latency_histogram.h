@@ -0,0 +1,102 @@
+#ifndef BASE_TRACING_LATENCY_HISTOGRAM_H_
+#define BASE_TRACING_LATENCY_HISTOGRAM_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "base/json/json.h"
+
+namespace base {
+
+namespace internal {
+class ThreadLatencyHistogram;
+}  // namespace internal
+
+// A log-linear histogram of durations in nanoseconds, in the style of HDR
+// histograms: every power of two is split into 16 linear buckets, so values
+// are reported to within 1/16th of their magnitude. Memory is fixed at about
+// 5KB regardless of how many values are recorded.
+class LatencyHistogram {
+ public:
+  static constexpr unsigned kSubBucketBits = 4;
+  static constexpr unsigned kSubBuckets = 1u << kSubBucketBits;
+  // Durations of 2^44ns (about 4.9 hours) or more share the last bucket.
+  static constexpr unsigned kMaxExponent = 44;
+  static constexpr size_t kBuckets =
+      (kMaxExponent - kSubBucketBits + 1) * kSubBuckets;
+
+  static size_t BucketFor(uint64_t value) {
+    if (value < kSubBuckets)
+      return value;
+    unsigned exponent = 63 - __builtin_clzll(value);
+    if (exponent >= kMaxExponent)
+      return kBuckets - 1;
+    return (exponent - kSubBucketBits + 1) * kSubBuckets +
+           ((value >> (exponent - kSubBucketBits)) & (kSubBuckets - 1));
+  }
+
+  static uint64_t BucketLowerBound(size_t bucket);
+
+  void Record(uint64_t value);
+  void Merge(const LatencyHistogram& other);
+
+  uint64_t count() const { return count_; }
+  uint64_t sum() const { return sum_; }
+  uint64_t min() const { return count_ ? min_ : 0; }
+  uint64_t max() const { return max_; }
+  uint64_t mean() const { return count_ ? sum_ / count_ : 0; }
+
+  // The highest value equivalent to the one at |percentile|, in [0, 100].
+  uint64_t Percentile(double percentile) const;
+
+  // {"count", "min", "mean", "p50", "p90", "p99", "p999", "max"}.
+  json::Object ToJson() const;
+
+ private:
+  friend class internal::ThreadLatencyHistogram;
+
+  uint64_t counts_[kBuckets] = {};
+  uint64_t count_ = 0;
+  uint64_t sum_ = 0;
+  uint64_t min_ = UINT64_MAX;
+  uint64_t max_ = 0;
+};
+
+namespace internal {
+
+// The per-thread half of a LatencyHistogram. Only the owning thread records,
+// using relaxed loads and stores rather than read-modify-writes, and any
+// thread may merge a (possibly slightly stale) copy out of it.
+class ThreadLatencyHistogram {
+ public:
+  // |weight| is the number of events a sampled one stands for.
+  void Record(uint64_t value, uint64_t weight = 1) {
+    Increment(counts_[LatencyHistogram::BucketFor(value)], weight);
+    Increment(count_, weight);
+    Increment(sum_, value * weight);
+    if (value < min_.load(std::memory_order_relaxed))
+      min_.store(value, std::memory_order_relaxed);
+    if (value > max_.load(std::memory_order_relaxed))
+      max_.store(value, std::memory_order_relaxed);
+  }
+
+  void MergeInto(LatencyHistogram* histogram) const;
+
+ private:
+  static void Increment(std::atomic<uint64_t>& counter, uint64_t by) {
+    counter.store(counter.load(std::memory_order_relaxed) + by,
+                  std::memory_order_relaxed);
+  }
+
+  std::atomic<uint64_t> counts_[LatencyHistogram::kBuckets] = {};
+  std::atomic<uint64_t> count_ = 0;
+  std::atomic<uint64_t> sum_ = 0;
+  std::atomic<uint64_t> min_ = UINT64_MAX;
+  std::atomic<uint64_t> max_ = 0;
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_TRACING_LATENCY_HISTOGRAM_H_
@@ -0,0 +1,175 @@
+#include "base/tracing/perf_counters.h"
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace base {
+
+namespace {
+
+struct CounterConfig {
+  uint32_t type;
+  uint64_t config;
+  const char* name;
+};
+
+constexpr CounterConfig kHardwareCounters[] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache_misses"},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch_misses"},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "context_switches"},
+};
+
+constexpr CounterConfig kSoftwareCounters[] = {
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, "task_clock_ns"},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "context_switches"},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS, "cpu_migrations"},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, "page_faults"},
+};
+
+static_assert(std::size(kHardwareCounters) <= PerfCounters::kMaxCounters);
+static_assert(std::size(kSoftwareCounters) <= PerfCounters::kMaxCounters);
+
+// Written once, under the once_flag in Initialize(), before |g_count| is
+// published.
+const CounterConfig* g_counters = nullptr;
+std::atomic<size_t> g_count = 0;
+
+// Opens |count| counters as one group, so that they're read together and
+// scheduled onto the PMU together. Returns the leader, or -1.
+int OpenGroup(const CounterConfig* counters, size_t count, int* fds) {
+  for (size_t i = 0; i < count; i++) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = counters[i].type;
+    attr.config = counters[i].config;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // Without CAP_PERFMON, hardware counters may only see user mode.
+    attr.exclude_kernel = counters[i].type == PERF_TYPE_HARDWARE;
+    attr.exclude_hv = 1;
+    fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1,
+                                      i ? fds[0] : -1, PERF_FLAG_FD_CLOEXEC));
+    if (fds[i] < 0) {
+      while (i--)
+        close(fds[i]);
+      return -1;
+    }
+  }
+  return fds[0];
+}
+
+class ThreadCounters {
+ public:
+  ~ThreadCounters() {
+    for (size_t i = 0; i < opened_; i++)
+      close(fds_[i]);
+  }
+
+  bool Read(PerfCounters::Reading* reading) {
+    if (!tried_) {
+      tried_ = true;
+      size_t count = g_count.load(std::memory_order_acquire);
+      if (count && OpenGroup(g_counters, count, fds_) >= 0)
+        opened_ = count;
+    }
+    if (!opened_)
+      return false;
+    // The number of counters, the times enabled and running, then each
+    // value.
+    uint64_t data[3 + PerfCounters::kMaxCounters];
+    ssize_t size = read(fds_[0], data, sizeof(data));
+    if (size < static_cast<ssize_t>(sizeof(uint64_t) * (3 + opened_)))
+      return false;
+    reading->enabled = data[1];
+    reading->running = data[2];
+    std::copy(data + 3, data + 3 + opened_, reading->values);
+    return true;
+  }
+
+ private:
+  bool tried_ = false;
+  size_t opened_ = 0;
+  int fds_[PerfCounters::kMaxCounters];
+};
+
+thread_local ThreadCounters g_thread_counters;
+
+}  // namespace
+
+// static
+bool PerfCounters::Initialize() {
+  static std::once_flag once;
+  std::call_once(once, []() {
+    int fds[kMaxCounters];
+    for (auto [counters, count] :
+         {std::make_pair(kHardwareCounters, std::size(kHardwareCounters)),
+          std::make_pair(kSoftwareCounters, std::size(kSoftwareCounters))}) {
+      if (OpenGroup(counters, count, fds) < 0)
+        continue;
+      for (size_t i = 0; i < count; i++)
+        close(fds[i]);
+      g_counters = counters;
+      g_count.store(count, std::memory_order_release);
+      return;
+    }
+  });
+  return count();
+}
+
+// static
+size_t PerfCounters::count() {
+  return g_count.load(std::memory_order_acquire);
+}
+
+// static
+const char* PerfCounters::name(size_t counter) {
+  return counter < count() ? g_counters[counter].name : "(unknown)";
+}
+
+// static
+bool PerfCounters::Read(Reading* reading) {
+  return g_thread_counters.Read(reading);
+}
+
+// static
+bool PerfCounters::Delta(const Reading& begin,
+                         const Reading& end,
+                         uint64_t* deltas) {
+  // Scaling each reading before subtracting could make the end's value the
+  // smaller one; the raw counts only ever grow.
+  uint64_t enabled = end.enabled - begin.enabled;
+  uint64_t running = end.running - begin.running;
+  if (!running || end.running < begin.running)
+    return false;
+  for (size_t i = 0; i < count(); i++) {
+    uint64_t delta = end.values[i] > begin.values[i]
+                         ? end.values[i] - begin.values[i]
+                         : 0;
+    deltas[i] = running < enabled
+                    ? static_cast<uint64_t>(static_cast<double>(delta) *
+                                            enabled / running)
+                    : delta;
+  }
+  return true;
+}
+
+json::Object PerfCounterStats::ToJson() const {
+  std::map<std::string, json::JSON> values;
+  values.insert({"events", static_cast<ssize_t>(events)});
+  for (size_t i = 0; i < PerfCounters::count(); i++)
+    values.insert({PerfCounters::name(i), static_cast<ssize_t>(totals[i])});
+  return json::Object(std::move(values));
+}
+
+}  // namespace base
@@ -0,0 +1,95 @@
+#ifndef BASE_TRACING_PERF_COUNTERS_H_
+#define BASE_TRACING_PERF_COUNTERS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "base/json/json.h"
+
+namespace base {
+
+// Per-thread perf_event_open(2) counters. Hardware counters (instructions,
+// cycles, cache and branch misses, plus context switches) are used when the
+// kernel and CPU allow it; otherwise, as in most VMs and containers, the
+// software ones (task clock, context switches, CPU migrations, page faults).
+// Only the calling thread is counted, in user and, for software counters,
+// kernel mode.
+class PerfCounters {
+ public:
+  static constexpr size_t kMaxCounters = 5;
+
+  // Picks the counter set, by trying to open it on the calling thread. Only
+  // the first call does any work. Returns false if no counters can be opened.
+  static bool Initialize();
+
+  // The number of counters in the chosen set, and their names. Zero before
+  // Initialize() succeeds.
+  static size_t count();
+  static const char* name(size_t counter);
+
+  // One reading of a thread's counters: the raw counts, and how long, in
+  // nanoseconds, the counters have been enabled and actually on the PMU.
+  struct Reading {
+    uint64_t enabled;
+    uint64_t running;
+    uint64_t values[kMaxCounters];
+  };
+
+  // Reads the calling thread's counters into |reading|, opening them the
+  // first time. Costs a read(2). Returns false if the counters can't be
+  // opened or read on this thread.
+  static bool Read(Reading* reading);
+
+  // Stores what each counter counted between |begin| and |end|, two readings
+  // on the same thread, into |deltas|, which has room for count() values. If
+  // the counters had to share the PMU in between, the deltas are scaled up to
+  // the whole time they were enabled, as perf(1) does. Returns false if the
+  // counters weren't scheduled onto the PMU at all in between.
+  static bool Delta(const Reading& begin,
+                    const Reading& end,
+                    uint64_t* deltas);
+};
+
+// The perf counter deltas of the TRACE_EVENTs of one name, summed over
+// every thread. Unlike allocations, these include nested events.
+struct PerfCounterStats {
+  uint64_t events = 0;
+  uint64_t totals[PerfCounters::kMaxCounters] = {};
+
+  // {"events", <counter name>: total...}.
+  json::Object ToJson() const;
+};
+
+namespace internal {
+
+// The per-thread half of PerfCounterStats. Only the owning thread records.
+class ThreadPerfCounterStats {
+ public:
+  // |weight| is the number of events a sampled one stands for.
+  void Record(const uint64_t* deltas, size_t count, uint64_t weight) {
+    Increment(events_, weight);
+    for (size_t i = 0; i < count; i++)
+      Increment(totals_[i], deltas[i] * weight);
+  }
+
+  void MergeInto(PerfCounterStats* stats) const {
+    stats->events += events_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < PerfCounters::kMaxCounters; i++)
+      stats->totals[i] += totals_[i].load(std::memory_order_relaxed);
+  }
+
+ private:
+  static void Increment(std::atomic<uint64_t>& counter, uint64_t by) {
+    counter.store(counter.load(std::memory_order_relaxed) + by,
+                  std::memory_order_relaxed);
+  }
+
+  std::atomic<uint64_t> events_ = 0;
+  std::atomic<uint64_t> totals_[PerfCounters::kMaxCounters] = {};
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_TRACING_PERF_COUNTERS_H_
@@ -0,0 +1,82 @@
+#include "base/tracing/proto_writer.h"
+
+#include <cstring>
+
+#include "base/check.h"
+
+namespace base {
+namespace internal {
+
+namespace {
+
+constexpr size_t kNestedLengthBytes = 4;
+constexpr size_t kMaxNestedLength = (1u << (7 * kNestedLengthBytes)) - 1;
+
+}  // namespace
+
+void ProtoWriter::AppendTag(uint32_t field, WireType type) {
+  AppendRawVarInt((static_cast<uint64_t>(field) << 3) | type);
+}
+
+void ProtoWriter::AppendRawVarInt(uint64_t value) {
+  char bytes[10];
+  size_t size = 0;
+  while (value >= 0x80) {
+    bytes[size++] = static_cast<char>(value | 0x80);
+    value >>= 7;
+  }
+  bytes[size++] = static_cast<char>(value);
+  data_.append(bytes, size);
+}
+
+void ProtoWriter::AppendVarInt(uint32_t field, uint64_t value) {
+  AppendTag(field, kVarInt);
+  AppendRawVarInt(value);
+}
+
+void ProtoWriter::AppendSignedVarInt(uint32_t field, int64_t value) {
+  // int64 fields, not sint64: negative numbers take ten bytes.
+  AppendVarInt(field, static_cast<uint64_t>(value));
+}
+
+void ProtoWriter::AppendFixed64(uint32_t field, uint64_t value) {
+  AppendTag(field, kFixed64);
+  char bytes[8];
+  for (size_t i = 0; i < sizeof(bytes); i++)
+    bytes[i] = static_cast<char>(value >> (8 * i));
+  data_.append(bytes, sizeof(bytes));
+}
+
+void ProtoWriter::AppendDouble(uint32_t field, double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  AppendFixed64(field, bits);
+}
+
+void ProtoWriter::AppendString(uint32_t field, std::string_view value) {
+  AppendTag(field, kLengthDelimited);
+  AppendRawVarInt(value.size());
+  data_.append(value.data(), value.size());
+}
+
+size_t ProtoWriter::BeginNested(uint32_t field) {
+  AppendTag(field, kLengthDelimited);
+  size_t token = data_.size();
+  data_.append(kNestedLengthBytes, '\0');
+  return token;
+}
+
+void ProtoWriter::EndNested(size_t token) {
+  size_t length = data_.size() - token - kNestedLengthBytes;
+  MCHECK(length <= kMaxNestedLength, "Nested proto message too large");
+  // A redundant varint: every byte but the last has its continuation bit set.
+  for (size_t i = 0; i < kNestedLengthBytes; i++) {
+    uint8_t byte = (length >> (7 * i)) & 0x7f;
+    if (i + 1 < kNestedLengthBytes)
+      byte |= 0x80;
+    data_[token + i] = static_cast<char>(byte);
+  }
+}
+
+}  // namespace internal
+}  // namespace base
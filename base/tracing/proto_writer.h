@@ -0,0 +1,50 @@
+#ifndef BASE_TRACING_PROTO_WRITER_H_
+#define BASE_TRACING_PROTO_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace base {
+namespace internal {
+
+// A minimal protobuf wire format encoder, enough to produce Perfetto traces
+// without depending on libprotobuf. Fields are appended to an in-memory
+// buffer; nested messages reserve a fixed four byte length which is patched
+// when the message ends, so nothing is ever encoded twice.
+class ProtoWriter {
+ public:
+  void AppendVarInt(uint32_t field, uint64_t value);
+  void AppendSignedVarInt(uint32_t field, int64_t value);
+  void AppendBool(uint32_t field, bool value) { AppendVarInt(field, value); }
+  void AppendFixed64(uint32_t field, uint64_t value);
+  void AppendDouble(uint32_t field, double value);
+  void AppendString(uint32_t field, std::string_view value);
+
+  // Returns a token to pass to EndNested() once the nested message's fields
+  // have been appended. Nested messages are limited to 256MiB.
+  size_t BeginNested(uint32_t field);
+  void EndNested(size_t token);
+
+  const std::string& data() const { return data_; }
+  size_t size() const { return data_.size(); }
+  void Clear() { data_.clear(); }
+
+ private:
+  enum WireType : uint32_t {
+    kVarInt = 0,
+    kFixed64 = 1,
+    kLengthDelimited = 2,
+  };
+
+  void AppendTag(uint32_t field, WireType type);
+  void AppendRawVarInt(uint64_t value);
+
+  std::string data_;
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_TRACING_PROTO_WRITER_H_
@@ -0,0 +1,115 @@
+#include "base/tracing/proto_writer.h"
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+
+#include "gtest/gtest.h"
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+
+namespace base {
+namespace internal {
+namespace {
+
+std::string Bytes(std::initializer_list<uint8_t> bytes) {
+  return std::string(bytes.begin(), bytes.end());
+}
+
+TEST(ProtoWriterTest, VarInts) {
+  ProtoWriter writer;
+  writer.AppendVarInt(1, 0);
+  writer.AppendVarInt(2, 1);
+  writer.AppendVarInt(3, 300);
+  writer.AppendVarInt(4, UINT64_MAX);
+  EXPECT_EQ(writer.data(),
+            Bytes({0x08, 0x00, 0x10, 0x01, 0x18, 0xac, 0x02, 0x20, 0xff, 0xff,
+                   0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01}));
+}
+
+TEST(ProtoWriterTest, LargeFieldNumbers) {
+  ProtoWriter writer;
+  writer.AppendVarInt(16, 1);
+  writer.AppendVarInt(60, 1);
+  EXPECT_EQ(writer.data(), Bytes({0x80, 0x01, 0x01, 0xe0, 0x03, 0x01}));
+}
+
+TEST(ProtoWriterTest, SignedVarIntsAreInt64) {
+  ProtoWriter writer;
+  writer.AppendSignedVarInt(1, 5);
+  writer.AppendSignedVarInt(1, -1);
+  EXPECT_EQ(writer.data(), Bytes({0x08, 0x05, 0x08, 0xff, 0xff, 0xff, 0xff,
+                                  0xff, 0xff, 0xff, 0xff, 0xff, 0x01}));
+}
+
+TEST(ProtoWriterTest, Bools) {
+  ProtoWriter writer;
+  writer.AppendBool(1, true);
+  writer.AppendBool(2, false);
+  EXPECT_EQ(writer.data(), Bytes({0x08, 0x01, 0x10, 0x00}));
+}
+
+TEST(ProtoWriterTest, Fixed64IsLittleEndian) {
+  ProtoWriter writer;
+  writer.AppendFixed64(1, 0x0102030405060708);
+  EXPECT_EQ(writer.data(),
+            Bytes({0x09, 0x08, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01}));
+}
+
+TEST(ProtoWriterTest, Doubles) {
+  ProtoWriter writer;
+  writer.AppendDouble(5, 1.0);
+  EXPECT_EQ(writer.data(),
+            Bytes({0x29, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf0, 0x3f}));
+}
+
+TEST(ProtoWriterTest, Strings) {
+  ProtoWriter writer;
+  writer.AppendString(2, "abc");
+  writer.AppendString(3, "");
+  EXPECT_EQ(writer.data(), Bytes({0x12, 0x03, 'a', 'b', 'c', 0x1a, 0x00}));
+
+  ProtoWriter long_string;
+  long_string.AppendString(1, std::string(200, 'x'));
+  EXPECT_EQ(long_string.data().substr(0, 3), Bytes({0x0a, 0xc8, 0x01}));
+  EXPECT_EQ(long_string.size(), 203u);
+}
+
+TEST(ProtoWriterTest, NestedMessagesHaveFourByteLengths) {
+  ProtoWriter writer;
+  size_t outer = writer.BeginNested(1);
+  writer.AppendVarInt(2, 3);
+  size_t inner = writer.BeginNested(4);
+  writer.EndNested(inner);
+  writer.EndNested(outer);
+  EXPECT_EQ(writer.data(),
+            Bytes({0x0a, 0x87, 0x80, 0x80, 0x00,     // 1: 7 bytes
+                   0x10, 0x03,                       // 2: 3
+                   0x22, 0x80, 0x80, 0x80, 0x00}));  // 4: empty
+}
+
+TEST(ProtoWriterTest, LongNestedMessages) {
+  ProtoWriter writer;
+  size_t nested = writer.BeginNested(1);
+  writer.AppendString(2, std::string(1000, 'x'));
+  writer.EndNested(nested);
+  // 1003 bytes: 0x6b, then 0x07.
+  EXPECT_EQ(writer.data().substr(0, 5), Bytes({0x0a, 0xeb, 0x87, 0x80, 0x00}));
+  EXPECT_EQ(writer.size(), 1 + 4 + 1003u);
+}
+
+TEST(ProtoWriterTest, Clear) {
+  ProtoWriter writer;
+  writer.AppendVarInt(1, 1);
+  writer.Clear();
+  EXPECT_EQ(writer.size(), 0u);
+  writer.AppendVarInt(1, 2);
+  EXPECT_EQ(writer.data(), Bytes({0x08, 0x02}));
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace base
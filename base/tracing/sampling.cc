@@ -0,0 +1,52 @@
+#include "base/tracing/sampling.h"
+
+#include <algorithm>
+
+#include "base/tracing/trace_clock.h"
+
+namespace base {
+namespace internal {
+
+void SamplingGroup::SetPolicy(const SamplingPolicy& policy) {
+  sampled_ = policy.interval() > 1 || policy.target_rate() > 0;
+  target_rate_.store(policy.target_rate(), std::memory_order_relaxed);
+  interval_.store(policy.interval(), std::memory_order_relaxed);
+  window_calls_.store(0, std::memory_order_relaxed);
+  window_samples_.store(0, std::memory_order_relaxed);
+  window_start_.store(0, std::memory_order_relaxed);
+}
+
+void SamplingGroup::Adapt(uint32_t weight) {
+  uint64_t timestamp = TraceClock::Now();
+  uint64_t calls =
+      window_calls_.fetch_add(weight, std::memory_order_relaxed) + weight;
+  uint64_t samples =
+      window_samples_.fetch_add(1, std::memory_order_relaxed) + 1;
+  uint64_t start = window_start_.load(std::memory_order_relaxed);
+  if (!start) {
+    window_start_.compare_exchange_strong(start, timestamp,
+                                          std::memory_order_relaxed);
+    return;
+  }
+  double target_rate = target_rate_.load(std::memory_order_relaxed);
+  // Cut the window short when far too much is being recorded, as when
+  // starting out at every call.
+  bool too_many = samples > 2 * target_rate * kWindowNanos / 1e9 + 1;
+  if (timestamp <= start || (timestamp < start + kWindowNanos && !too_many))
+    return;
+  // One thread per window gets to retune.
+  if (!window_start_.compare_exchange_strong(start, timestamp,
+                                             std::memory_order_relaxed)) {
+    return;
+  }
+  window_calls_.fetch_sub(calls, std::memory_order_relaxed);
+  window_samples_.fetch_sub(samples, std::memory_order_relaxed);
+  double calls_per_second = calls * 1e9 / (timestamp - start);
+  double interval = calls_per_second / target_rate;
+  interval_.store(static_cast<uint32_t>(std::clamp(
+                      interval, 1.0, static_cast<double>(kMaxInterval))),
+                  std::memory_order_relaxed);
+}
+
+}  // namespace internal
+}  // namespace base
@@ -0,0 +1,82 @@
+#ifndef BASE_TRACING_SAMPLING_H_
+#define BASE_TRACING_SAMPLING_H_
+
+#include <atomic>
+#include <cstdint>
+
+namespace base {
+
+// How many of a TRACE_EVENT's calls to record. A sampled event carries the
+// number of calls it stands for as its weight, which the in-process
+// summaries multiply by and exports include as a "sample_weight" argument.
+class SamplingPolicy {
+ public:
+  // Every call.
+  static SamplingPolicy All() { return SamplingPolicy(1, 0); }
+
+  // One call in |n|, on each thread.
+  static SamplingPolicy OneIn(uint32_t n) {
+    return SamplingPolicy(n ? n : 1, 0);
+  }
+
+  // Roughly |events_per_second| recorded calls across the process, however
+  // often the event runs. The interval adapts every 100ms, or sooner when
+  // twice the target is being recorded.
+  static SamplingPolicy TargetRate(double events_per_second) {
+    return SamplingPolicy(1, events_per_second);
+  }
+
+  uint32_t interval() const { return interval_; }
+  double target_rate() const { return target_rate_; }
+
+ private:
+  SamplingPolicy(uint32_t interval, double target_rate)
+      : interval_(interval), target_rate_(target_rate) {}
+
+  uint32_t interval_;
+  double target_rate_;
+};
+
+namespace internal {
+
+// The shared state of the events that one policy applies to.
+class SamplingGroup {
+ public:
+  static constexpr uint64_t kWindowNanos = 100 * 1000 * 1000;
+  static constexpr uint32_t kMaxInterval = 1 << 20;
+
+  void SetPolicy(const SamplingPolicy& policy);
+
+  // Whether the policy skips any calls at all.
+  bool sampled() const { return sampled_; }
+
+  // Calls between recorded ones, on each thread.
+  uint32_t interval() const {
+    return interval_.load(std::memory_order_relaxed);
+  }
+
+  // Called for each recorded call, standing for |weight| calls. Adapts the
+  // interval for a target rate.
+  void OnSample(uint32_t weight) {
+    if (target_rate_.load(std::memory_order_relaxed) > 0)
+      Adapt(weight);
+  }
+
+ private:
+  void Adapt(uint32_t weight);
+
+  // Only changed along with the Tracer's frame assignments, under its lock.
+  bool sampled_ = false;
+
+  std::atomic<uint32_t> interval_ = 1;
+  std::atomic<double> target_rate_ = 0;
+  // Estimated calls, and samples taken, since |window_start_|.
+  std::atomic<uint64_t> window_calls_ = 0;
+  std::atomic<uint64_t> window_samples_ = 0;
+  std::atomic<uint64_t> window_start_ = 0;
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_TRACING_SAMPLING_H_
@@ -0,0 +1,79 @@
+#ifndef BASE_TRACING_THREAD_FRAME_TABLE_H_
+#define BASE_TRACING_THREAD_FRAME_TABLE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace base {
+namespace internal {
+
+// Per-thread statistics of type |T|, indexed by frame and allocated on first
+// use. Two levels deep, so a thread that traces a handful of names stays
+// small. Only the owning thread creates entries; any thread may Find() them.
+template <typename T>
+class ThreadFrameTable {
+ public:
+  static constexpr size_t kPageSize = 256;
+
+  explicit ThreadFrameTable(size_t max_frames)
+      : page_count_((max_frames + kPageSize - 1) / kPageSize),
+        pages_(new std::atomic<std::atomic<T*>*>[page_count_]()) {}
+
+  ~ThreadFrameTable() {
+    for (size_t i = 0; i < page_count_; i++) {
+      std::atomic<T*>* page = pages_[i].load();
+      if (!page)
+        continue;
+      for (size_t j = 0; j < kPageSize; j++)
+        delete page[j].load();
+      delete[] page;
+    }
+    delete[] pages_;
+  }
+
+  ThreadFrameTable(const ThreadFrameTable&) = delete;
+  ThreadFrameTable& operator=(const ThreadFrameTable&) = delete;
+
+  // Owning thread only.
+  T* Get(uint32_t frame) {
+    std::atomic<T*>* page =
+        pages_[frame / kPageSize].load(std::memory_order_relaxed);
+    T* entry = nullptr;
+    if (page)
+      entry = page[frame % kPageSize].load(std::memory_order_relaxed);
+    return entry ? entry : Create(frame);
+  }
+
+  // Any thread. Returns null if |frame| has no entry on this thread.
+  const T* Find(uint32_t frame) const {
+    if (frame / kPageSize >= page_count_)
+      return nullptr;
+    std::atomic<T*>* page =
+        pages_[frame / kPageSize].load(std::memory_order_acquire);
+    if (!page)
+      return nullptr;
+    return page[frame % kPageSize].load(std::memory_order_acquire);
+  }
+
+ private:
+  T* Create(uint32_t frame) {
+    std::atomic<T*>* page =
+        pages_[frame / kPageSize].load(std::memory_order_relaxed);
+    if (!page) {
+      page = new std::atomic<T*>[kPageSize]();
+      pages_[frame / kPageSize].store(page, std::memory_order_release);
+    }
+    T* entry = new T();
+    page[frame % kPageSize].store(entry, std::memory_order_release);
+    return entry;
+  }
+
+  const size_t page_count_;
+  std::atomic<std::atomic<T*>*>* const pages_;
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_TRACING_THREAD_FRAME_TABLE_H_
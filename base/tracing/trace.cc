@@ -1,71 +1,123 @@
-
 #include "trace.h"
-#include "base/json/json.h"
-#include "base/json/json_io.h"
+#include "base/tracing/flight_recorder.h"
+#include "base/tracing/trace_clock.h"
+#include "base/tracing/trace_export.h"
+#include "base/tracing/trace_socket.h"
+#include "base/tracing/trace_streamer.h"
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
-#include <chrono>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 
 namespace base {
 
-namespace {
+namespace internal {
 
-size_t ms() {
-  return std::chrono::duration_cast<std::chrono::milliseconds>(
-             std::chrono::system_clock::now().time_since_epoch())
-      .count();
+ThreadTraceBuffer::ThreadTraceBuffer(uint64_t thread_id,
+                                     std::string thread_name)
+    : head_(new TraceChunk()),
+      tail_(head_),
+      thread_id_(thread_id),
+      thread_name_(std::move(thread_name)) {}
+
+ThreadTraceBuffer::~ThreadTraceBuffer() {
+  TraceChunk* chunk = head_.load(std::memory_order_relaxed);
+  while (chunk) {
+    TraceChunk* next = chunk->next.load(std::memory_order_relaxed);
+    delete chunk;
+    chunk = next;
+  }
 }
 
-}  // namespace
+void TraceSite::Resolve() {
+  Tracer* tracer = Tracer::Get();
+  frame_.store(tracer->InternFrame(category, name),
+               std::memory_order_relaxed);
+  category_bit_.store(tracer->CategoryBit(category),
+                      std::memory_order_relaxed);
+}
+
+void ThreadTraceBuffer::NewChunk() {
+  Tracer* tracer = Tracer::Get();
+  if (TraceStreamer* streamer = tracer->streamer()) {
+    streamer->HandOff(this);
+    return;
+  }
+  TraceChunk* chunk;
+  size_t ring_chunks = tracer->ring_chunks();
+  if (ring_chunks && chunk_count_ >= ring_chunks) {
+    // Flight recorder: the oldest chunk becomes the newest.
+    chunk = head_.load(std::memory_order_relaxed);
+    head_.store(chunk->next.load(std::memory_order_relaxed),
+                std::memory_order_release);
+    chunk->next.store(nullptr, std::memory_order_relaxed);
+    // Before any of the new records, for readers that may be looking at the
+    // chunk's previous contents.
+    chunk->sequence.store(++chunk_sequence_, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    chunk->committed.store(0, std::memory_order_release);
+  } else {
+    chunk = new TraceChunk();
+    chunk->sequence.store(++chunk_sequence_, std::memory_order_relaxed);
+    chunk_count_++;
+  }
+  tail_->next.store(chunk, std::memory_order_release);
+  tail_ = chunk;
+  size_ = 0;
+}
+
+}  // namespace internal
 
 Tracer::Tracer() {
-  initial_ = ms();
+  TraceClock::Initialize();
+  Calibrate();
+}
+
+void Tracer::Calibrate() {
+  // Best of a few rounds, all within one chunk of a private buffer, so that
+  // nothing reaches the trace and nothing calls back into the Tracer.
+  constexpr int kRounds = 4;
+  constexpr int kIterations = internal::TraceChunk::kCapacity / kRounds / 2;
+  internal::ThreadTraceBuffer buffer(0, "calibration");
+  uint64_t best_records = UINT64_MAX;
+  uint64_t best_clock_reads = UINT64_MAX;
+  for (int round = 0; round < kRounds; round++) {
+    uint64_t start = TraceClock::Now();
+    for (int i = 0; i < kIterations; i++) {
+      buffer.Append(start, 0, internal::TraceRecord::kBegin);
+      buffer.Append(start, 0, internal::TraceRecord::kEnd);
+    }
+    uint64_t middle = TraceClock::Now();
+    for (int i = 0; i < kIterations * 2; i++)
+      TraceClock::Now();
+    uint64_t end = TraceClock::Now();
+    best_records = std::min(best_records, middle - start);
+    best_clock_reads = std::min(best_clock_reads, end - middle);
+  }
+  record_ns_ = static_cast<double>(best_records) / (kIterations * 2);
+  clock_read_ns_ = static_cast<double>(best_clock_reads) / (kIterations * 2);
 }
 
 Tracer::~Tracer() {
-  if (!print_)
+  std::lock_guard<std::mutex> guard(lock_);
+  socket_server_.reset();
+  if (internal::TraceStreamer* streamer = streamer_.exchange(nullptr)) {
+    streamer->Finish(buffers_);
+    delete streamer;
+    return;
+  }
+  if (!exit_format_)
+    return;
+  if (exit_path_.empty()) {
+    Export(*exit_format_, buffers_, std::cout);
     return;
-  std::map<std::string, json::JSON> schema;
-  schema.insert({"exporter", "base/trace"});
-  schema.insert({"name", "trace.json"});
-  schema.insert({"activeProfileIndex", 0});
-  schema.insert(
-      {"$schema", "https://www.speedscope.app/file-format-schema.json"});
-
-  std::map<std::string, json::JSON> shared;
-  std::vector<json::JSON> frames;
-  for (const std::string& frname : frames_) {
-    std::map<std::string, json::JSON> blob;
-    blob.insert({"name", frname});
-    frames.emplace_back(std::move(blob));
-  }
-  shared.insert({"frames", std::move(frames)});
-  schema.insert({"shared", std::move(shared)});
-
-  std::vector<json::JSON> profiles;
-  std::map<std::string, json::JSON> profile_map;
-  profile_map.insert({"type", "evented"});
-  profile_map.insert({"name", "trace"});
-  profile_map.insert({"unit", "none"});
-  profile_map.insert({"startValue", 0});
-  ssize_t last_event_frame_no = 0;
-  std::vector<json::JSON> events;
-  for (const auto& ev : events_) {
-    last_event_frame_no =
-        std::max(static_cast<ssize_t>(std::get<1>(ev)), last_event_frame_no);
-    std::map<std::string, json::JSON> blob;
-    blob.insert({"type", std::get<0>(ev) ? "O" : "C"});
-    blob.insert({"frame", static_cast<ssize_t>(std::get<1>(ev))});
-    blob.insert({"at", static_cast<ssize_t>(std::get<2>(ev))});
-    events.emplace_back(std::move(blob));
-  }
-  profile_map.insert({"endValue", last_event_frame_no});
-  profile_map.insert({"events", std::move(events)});
-  profiles.emplace_back(std::move(profile_map));
-  schema.insert({"profiles", std::move(profiles)});
-
-  json::Object report(std::move(schema));
-  std::cout << report << "\n";
+  }
+  std::ofstream file(exit_path_, std::ios::binary | std::ios::trunc);
+  Export(*exit_format_, buffers_, file);
 }
 
 // static
@@ -74,23 +126,426 @@ Tracer* Tracer::Get() {
   return &tracer;
 }
 
-size_t Tracer::StartEvent(std::string e) {
-  size_t vec_size = frames_.size();
-  std::time_t current = ms() - initial_;
-  frames_.push_back(e);
-  events_.push_back(
-      std::make_tuple<bool, size_t, size_t>(true, vec_size + 0, current));
-  return vec_size;
+internal::ThreadTraceBuffer* Tracer::RegisterCurrentThread() {
+  char name[16] = {0};
+  if (pthread_getname_np(pthread_self(), name, sizeof(name)))
+    name[0] = '\0';
+  auto buffer = std::make_unique<internal::ThreadTraceBuffer>(
+      static_cast<uint64_t>(syscall(SYS_gettid)), name);
+  std::lock_guard<std::mutex> guard(lock_);
+  buffer->next_registered_ =
+      registered_buffers_.load(std::memory_order_relaxed);
+  registered_buffers_.store(buffer.get(), std::memory_order_release);
+  buffers_.push_back(std::move(buffer));
+  return buffers_.back().get();
+}
+
+uint32_t Tracer::InternFrame(const char* category, const char* name) {
+  std::lock_guard<std::mutex> guard(lock_);
+  auto existing = frame_ids_.find({category, name});
+  if (existing != frame_ids_.end())
+    return existing->second;
+  uint32_t frame = frame_count_.load(std::memory_order_relaxed);
+  if (frame == kMaxFrames - 1) {
+    // Keep the last slot as a catch-all so that a runaway number of names
+    // still produces a readable trace.
+    frames_[frame] = "(too many trace names)";
+    frame_categories_[frame] = CategoryIndexLocked(category);
+    frame_count_.store(kMaxFrames, std::memory_order_release);
+  }
+  if (frame >= kMaxFrames - 1)
+    return kMaxFrames - 1;
+  frames_[frame] = name;
+  frame_categories_[frame] = CategoryIndexLocked(category);
+  frame_sampling_groups_[frame].store(SamplingGroupLocked(category, name),
+                                      std::memory_order_relaxed);
+  frame_count_.store(frame + 1, std::memory_order_release);
+  frame_ids_.emplace(std::make_pair(category, name), frame);
+  return frame;
+}
+
+const char* Tracer::FrameName(uint32_t frame) const {
+  if (frame >= frame_count_.load(std::memory_order_acquire))
+    return "(unknown)";
+  return frames_[frame];
+}
+
+const char* Tracer::FrameCategory(uint32_t frame) const {
+  if (frame >= frame_count_.load(std::memory_order_acquire))
+    return "(unknown)";
+  return categories_[frame_categories_[frame]];
+}
+
+uint64_t Tracer::CategoryBit(const char* category) {
+  std::lock_guard<std::mutex> guard(lock_);
+  return uint64_t{1} << CategoryIndexLocked(category);
+}
+
+uint8_t Tracer::CategoryIndexLocked(const char* category) {
+  uint32_t count = category_count_.load(std::memory_order_relaxed);
+  for (uint32_t i = 0; i < count; i++) {
+    if (!strcmp(categories_[i], category))
+      return i;
+  }
+  if (count == kMaxCategories)
+    return kMaxCategories - 1;
+  categories_[count] = category;
+  category_count_.store(count + 1, std::memory_order_release);
+  UpdateEnabledMaskLocked();
+  return count;
+}
+
+void Tracer::SetEnabledCategories(std::string_view categories) {
+  std::lock_guard<std::mutex> guard(lock_);
+  enable_all_categories_ = false;
+  enabled_category_names_.clear();
+  while (!categories.empty()) {
+    size_t comma = categories.find(',');
+    std::string_view category = categories.substr(0, comma);
+    if (category == "*")
+      enable_all_categories_ = true;
+    else if (!category.empty())
+      enabled_category_names_.emplace(category);
+    if (comma == std::string_view::npos)
+      break;
+    categories.remove_prefix(comma + 1);
+  }
+  UpdateEnabledMaskLocked();
+}
+
+void Tracer::UpdateEnabledMaskLocked() {
+  uint64_t mask = 0;
+  if (enable_all_categories_) {
+    mask = ~uint64_t{0};
+  } else {
+    uint32_t count = category_count_.load(std::memory_order_relaxed);
+    size_t seen = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      if (enabled_category_names_.count(std::string_view(categories_[i]))) {
+        mask |= uint64_t{1} << i;
+        seen++;
+      }
+    }
+    if (seen < enabled_category_names_.size())
+      mask |= uint64_t{1} << kMaxCategories;
+  }
+  enabled_categories_.store(mask, std::memory_order_relaxed);
+}
+
+uint32_t Tracer::FrameCount() const {
+  return frame_count_.load(std::memory_order_acquire);
+}
+
+void Tracer::SetRecordModes(uint32_t modes) {
+  if (!internal::allocation_hooks_linked)
+    modes &= ~kRecordAllocations;
+  if ((modes & kRecordPerfCounters) && !PerfCounters::Initialize())
+    modes &= ~kRecordPerfCounters;
+  record_modes_.store(modes, std::memory_order_relaxed);
+}
+
+void Tracer::SetSampling(std::string_view category,
+                         const SamplingPolicy& policy) {
+  std::lock_guard<std::mutex> guard(lock_);
+  SetSamplingLocked(std::string(category), policy);
 }
 
-void Tracer::EndEvent(size_t key) {
-  std::time_t current = ms() - initial_;
-  events_.push_back(
-      std::make_tuple<bool, size_t, size_t>(false, std::move(key), current));
+void Tracer::SetSampling(std::string_view category,
+                         std::string_view name,
+                         const SamplingPolicy& policy) {
+  std::lock_guard<std::mutex> guard(lock_);
+  SetSamplingLocked(std::string(category) + "/" + std::string(name), policy);
+}
+
+void Tracer::SetSamplingLocked(std::string key, const SamplingPolicy& policy) {
+  auto [it, inserted] = sampling_group_ids_.emplace(std::move(key), 0);
+  if (inserted) {
+    it->second = static_cast<uint8_t>(
+        std::min(sampling_group_ids_.size(), kMaxSamplingGroups - 1));
+  }
+  sampling_groups_[it->second].SetPolicy(policy);
+  for (const auto& [frame_key, frame] : frame_ids_) {
+    frame_sampling_groups_[frame].store(
+        SamplingGroupLocked(frame_key.first, frame_key.second),
+        std::memory_order_relaxed);
+  }
+}
+
+uint8_t Tracer::SamplingGroupLocked(std::string_view category,
+                                    std::string_view name) const {
+  if (sampling_group_ids_.empty())
+    return 0;
+  std::string key(category);
+  auto group = sampling_group_ids_.end();
+  if (!name.empty())
+    group = sampling_group_ids_.find(key + "/" + std::string(name));
+  if (group == sampling_group_ids_.end())
+    group = sampling_group_ids_.find(key);
+  if (group == sampling_group_ids_.end() ||
+      !sampling_groups_[group->second].sampled()) {
+    return 0;
+  }
+  return group->second;
+}
+
+// static
+uint32_t Tracer::TakeSample(uint8_t group) {
+  SampleCountdown& countdown = sample_countdowns_[group];
+  uint32_t weight = countdown.weight ? countdown.weight : 1;
+  uint32_t interval = sampling_groups_[group].interval();
+  countdown = {interval, interval};
+  sampling_groups_[group].OnSample(weight);
+  return weight;
+}
+
+LatencyHistogram Tracer::GetHistogram(uint32_t frame) {
+  LatencyHistogram histogram;
+  std::lock_guard<std::mutex> guard(lock_);
+  for (const auto& buffer : buffers_) {
+    if (const auto* thread_histogram = buffer->histograms().Find(frame))
+      thread_histogram->MergeInto(&histogram);
+  }
+  return histogram;
+}
+
+std::optional<LatencyHistogram> Tracer::GetHistogram(std::string_view category,
+                                                     std::string_view name) {
+  uint32_t frame;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    auto existing = frame_ids_.find({category, name});
+    if (existing == frame_ids_.end())
+      return std::nullopt;
+    frame = existing->second;
+  }
+  return GetHistogram(frame);
+}
+
+json::Object Tracer::DumpHistograms() {
+  std::map<std::string, json::JSON> histograms;
+  uint32_t frame_count = FrameCount();
+  for (uint32_t frame = 0; frame < frame_count; frame++) {
+    LatencyHistogram histogram = GetHistogram(frame);
+    if (!histogram.count())
+      continue;
+    histograms.insert({std::string(FrameCategory(frame)) + "/" +
+                           FrameName(frame),
+                       histogram.ToJson()});
+  }
+  return json::Object(std::move(histograms));
+}
+
+AllocationStats Tracer::GetAllocationStats(uint32_t frame) {
+  AllocationStats stats;
+  std::lock_guard<std::mutex> guard(lock_);
+  for (const auto& buffer : buffers_) {
+    if (const auto* thread_stats = buffer->allocations().Find(frame))
+      thread_stats->MergeInto(&stats);
+  }
+  return stats;
+}
+
+json::Object Tracer::DumpAllocations() {
+  std::map<std::string, json::JSON> allocations;
+  uint32_t frame_count = FrameCount();
+  for (uint32_t frame = 0; frame < frame_count; frame++) {
+    AllocationStats stats = GetAllocationStats(frame);
+    if (!stats.events)
+      continue;
+    allocations.insert({std::string(FrameCategory(frame)) + "/" +
+                            FrameName(frame),
+                        stats.ToJson()});
+  }
+  return json::Object(std::move(allocations));
+}
+
+PerfCounterStats Tracer::GetPerfCounterStats(uint32_t frame) {
+  PerfCounterStats stats;
+  std::lock_guard<std::mutex> guard(lock_);
+  for (const auto& buffer : buffers_) {
+    if (const auto* thread_stats = buffer->perf_counters().Find(frame))
+      thread_stats->MergeInto(&stats);
+  }
+  return stats;
+}
+
+json::Object Tracer::DumpPerfCounters() {
+  std::map<std::string, json::JSON> perf_counters;
+  uint32_t frame_count = FrameCount();
+  for (uint32_t frame = 0; frame < frame_count; frame++) {
+    PerfCounterStats stats = GetPerfCounterStats(frame);
+    if (!stats.events)
+      continue;
+    perf_counters.insert({std::string(FrameCategory(frame)) + "/" +
+                              FrameName(frame),
+                          stats.ToJson()});
+  }
+  return json::Object(std::move(perf_counters));
+}
+
+TracerOverhead Tracer::Overhead() const {
+  TracerOverhead overhead;
+  overhead.clock_read_ns = clock_read_ns_;
+  overhead.record_ns = record_ns_;
+  for (const internal::ThreadTraceBuffer* buffer = registered_buffers();
+       buffer; buffer = buffer->next_registered()) {
+    overhead.records += buffer->records();
+  }
+  overhead.buffer_bytes =
+      internal::TraceChunk::live_count.load(std::memory_order_relaxed) *
+      sizeof(internal::TraceChunk);
+  overhead.exports = exports_.load(std::memory_order_relaxed);
+  overhead.export_ns = export_nanos_.load(std::memory_order_relaxed);
+  if (uint64_t start = export_start_.load(std::memory_order_relaxed))
+    overhead.export_ns += TraceClock::Now() - start;
+  return overhead;
 }
 
 void Tracer::PrintOnExit() {
-  print_ = true;
+  SetEnabledCategories("*");
+  ExportOnExit(TraceFormat::kSpeedscope, "");
+}
+
+void Tracer::ExportOnExit(TraceFormat format, std::string path) {
+  std::lock_guard<std::mutex> guard(lock_);
+  exit_format_ = format;
+  exit_path_ = std::move(path);
+}
+
+bool Tracer::Export(TraceFormat format, std::ostream& out) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (streamer())
+    return false;
+  Export(format, buffers_, out);
+  return true;
+}
+
+void Tracer::Export(
+    TraceFormat format,
+    const std::vector<std::unique_ptr<internal::ThreadTraceBuffer>>& buffers,
+    std::ostream& out) {
+  uint64_t start = TraceClock::Now();
+  exports_.fetch_add(1, std::memory_order_relaxed);
+  export_start_.store(start, std::memory_order_relaxed);
+  switch (format) {
+    case TraceFormat::kSpeedscope:
+      internal::WriteSpeedscope(this, buffers, out);
+      break;
+    case TraceFormat::kChromeJson:
+      internal::WriteChromeJson(this, buffers, out);
+      break;
+    case TraceFormat::kPerfetto:
+      internal::WritePerfetto(this, buffers, out);
+      break;
+  }
+  export_start_.store(0, std::memory_order_relaxed);
+  export_nanos_.fetch_add(TraceClock::Now() - start,
+                          std::memory_order_relaxed);
+}
+
+bool Tracer::StartFlightRecorder(const std::string& path,
+                                 size_t bytes_per_thread) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (streamer_.load() || ring_chunks_.load())
+    return false;
+  ring_chunks_.store(
+      std::max<size_t>(bytes_per_thread / sizeof(internal::TraceChunk), 2));
+  internal::FlightRecorder::Install(this, path);
+  return true;
+}
+
+bool Tracer::ServeOnSocket(const std::string& path) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (socket_server_ || streamer_.load())
+    return false;
+  socket_server_ = internal::TraceSocketServer::Create(this, path);
+  return socket_server_ != nullptr;
+}
+
+bool Tracer::StreamToFile(const std::string& path, size_t max_buffer_bytes) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (streamer_.load() || ring_chunks_.load() || socket_server_)
+    return false;
+  auto file = std::make_unique<std::ofstream>(path, std::ios::trunc);
+  if (!file->is_open())
+    return false;
+  size_t max_chunks =
+      std::max<size_t>(max_buffer_bytes / sizeof(internal::TraceChunk), 2);
+  streamer_.store(
+      new internal::TraceStreamer(this, std::move(file), max_chunks),
+      std::memory_order_release);
+  return true;
+}
+
+void TraceEvent::Enter() {
+  internal::TraceEventStack& stack = internal::trace_event_stack;
+  uint32_t weight = Tracer::SampleWeight(frame_);
+  if (!weight || stack.depth == internal::TraceEventStack::kMaxDepth) {
+    frame_ = internal::TraceSite::kDisabledFrame;
+    return;
+  }
+  internal::TraceEventState& state = stack.states[stack.depth++];
+  state.weight = weight;
+  state.modes = 0;
+}
+
+void TraceEvent::End() {
+  uint64_t end = TraceClock::Now();
+  internal::TraceEventStack& stack = internal::trace_event_stack;
+  const internal::TraceEventState& state = stack.top();
+  if ((state.modes &
+       (Tracer::kRecordAllocations | Tracer::kRecordPerfCounters)) ||
+      state.weight != 1) {
+    EndWithArgs(state, end);
+  } else if (state.modes & Tracer::kRecordTimeline) {
+    Tracer::EndEvent(frame_, end);
+  }
+  if (state.modes & Tracer::kRecordHistograms)
+    Tracer::RecordDuration(frame_, end - state.begin, state.weight);
+  stack.depth--;
+}
+
+void TraceEvent::EndWithArgs(const internal::TraceEventState& state,
+                             uint64_t end) {
+  constexpr size_t kMaxValues = PerfCounters::kMaxCounters + 3;
+  const char* keys[kMaxValues];
+  uint64_t values[kMaxValues];
+  size_t count = 0;
+  // Perf counters first, and allocations before anything that might
+  // allocate, so that as little as possible of the tracer's own work counts.
+  // An event without both readings gets no counters rather than bogus ones.
+  PerfCounters::Reading now;
+  bool perf_counters =
+      (state.modes & Tracer::kRecordPerfCounters) &&
+      state.perf_counters_read && PerfCounters::Read(&now) &&
+      PerfCounters::Delta(state.perf_counters, now, values);
+  if (perf_counters) {
+    for (; count < PerfCounters::count(); count++)
+      keys[count] = PerfCounters::name(count);
+  }
+  size_t perf_count = count;
+  internal::ThreadAllocationCounters allocations = {};
+  if (state.modes & Tracer::kRecordAllocations) {
+    allocations = internal::thread_allocations;
+    keys[count] = "allocations";
+    values[count++] = allocations.count;
+    keys[count] = "allocated_bytes";
+    values[count++] = allocations.bytes;
+  }
+  if (state.weight != 1) {
+    keys[count] = "sample_weight";
+    values[count++] = state.weight;
+  }
+
+  if (state.modes & Tracer::kRecordTimeline)
+    Tracer::EndEventWithUintArgs(frame_, end, keys, values, count);
+  if (perf_counters)
+    Tracer::RecordPerfCounters(frame_, values, perf_count, state.weight);
+  if (state.modes & Tracer::kRecordAllocations) {
+    Tracer::RecordAllocations(frame_, allocations, state.weight);
+    // Back to counting for the enclosing event.
+    internal::thread_allocations = state.saved_allocations;
+  }
 }
 
-}  // namespace base
\ No newline at end of file
+}  // namespace base
@@ -1,47 +1,810 @@
-
 #ifndef BASE_TRACING_TRACE_H_
 #define BASE_TRACING_TRACE_H_
 
+#include <atomic>
+#include <algorithm>
 #include <cstddef>
-#include <ctime>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <set>
 #include <string>
-#include <tuple>
+#include <string_view>
+#include <utility>
 #include <vector>
 
+#include "base/json/json.h"
+#include "base/tracing/allocation_accounting.h"
+#include "base/tracing/latency_histogram.h"
+#include "base/tracing/perf_counters.h"
+#include "base/tracing/sampling.h"
+#include "base/tracing/trace_clock.h"
+#include "base/tracing/thread_frame_table.h"
+#include "base/tracing/trace_record.h"
+#include "base/tracing/tracer_overhead.h"
+
 namespace base {
 
+class Tracer;
+
+namespace internal {
+
+// Frame ids are dense and below this bound.
+constexpr size_t kMaxTraceFrames = 16384;
+static_assert(kMaxTraceFrames <= UINT16_MAX, "TraceRecord::frame is 16 bits");
+
+// A fixed size block of slots. Only the owning thread writes into a chunk;
+// it publishes each event by bumping |committed| so that a reader on another
+// thread never looks at a half written one.
+struct TraceChunk {
+  static constexpr size_t kCapacity = 4096;
+
+  TraceChunk() { live_count.fetch_add(1, std::memory_order_relaxed); }
+  ~TraceChunk() { live_count.fetch_sub(1, std::memory_order_relaxed); }
+
+  // Chunks allocated in the process, for TracerOverhead.
+  static inline std::atomic<size_t> live_count = 0;
+
+  std::atomic<size_t> committed = 0;
+  std::atomic<TraceChunk*> next = nullptr;
+  // Distinguishes the chunk's uses as the flight recorder recycles it.
+  std::atomic<uint64_t> sequence = 0;
+  TraceSlot slots[kCapacity];
+};
+
+// Per-thread event storage. Appending never locks and never writes to memory
+// that another thread writes to; the Tracer only reads it when exporting.
+class TraceSocketServer;
+class TraceStreamer;
+
+class alignas(64) ThreadTraceBuffer {
+ public:
+  ThreadTraceBuffer(uint64_t thread_id, std::string thread_name);
+  ~ThreadTraceBuffer();
+
+  void Append(uint64_t timestamp, uint32_t frame, TraceRecord::Type type) {
+    TraceSlot* slot = Reserve(1);
+    SetRecord(slot, timestamp, frame, type, 0);
+    Commit();
+  }
+
+  void Append(uint64_t timestamp,
+              uint32_t frame,
+              TraceRecord::Type type,
+              uint64_t payload) {
+    TraceSlot* slots = Reserve(2);
+    SetRecord(slots, timestamp, frame, type, 1);
+    slots[1].payload = payload;
+    Commit();
+  }
+
+  // Appends a record followed by TRACE_EVENT style key, value arguments.
+  template <typename... Args>
+  void AppendWithArgs(uint64_t timestamp,
+                      uint32_t frame,
+                      TraceRecord::Type type,
+                      Args&&... args) {
+    size_t extra_slots = CountTraceArgSlots(args...);
+    TraceSlot* slots = Reserve(1 + extra_slots);
+    SetRecord(slots, timestamp, frame, type, extra_slots);
+    WriteTraceArgs(slots + 1, &slots->record.arg_types, 0, args...);
+    Commit();
+  }
+
+  // Appends a record with unsigned arguments that are only known at run time.
+  void AppendWithUintArgs(uint64_t timestamp,
+                          uint32_t frame,
+                          TraceRecord::Type type,
+                          const char* const* keys,
+                          const uint64_t* values,
+                          size_t count) {
+    TraceSlot* slots = Reserve(1 + count);
+    SetRecord(slots, timestamp, frame, type, count);
+    for (size_t i = 0; i < count; i++) {
+      slots[1 + i].arg.key = keys[i];
+      slots[1 + i].arg.uint_value = values[i];
+      slots->record.arg_types |= uint32_t{TraceArg::kUint} << (4 * i);
+    }
+    Commit();
+  }
+
+  // Calls |visit(record, extra)| on every published event, oldest first.
+  // Safe to call from any thread while the owner keeps appending.
+  template <typename Visitor>
+  void ForEachRecord(Visitor visit) const {
+    for (const TraceChunk* chunk = head_.load(std::memory_order_acquire); chunk;
+         chunk = chunk->next.load(std::memory_order_acquire)) {
+      ForEachRecordIn(chunk->slots,
+                      chunk->committed.load(std::memory_order_acquire), visit);
+    }
+  }
+
+  // Like ForEachRecord(), but visits at most |max_chunks| chunks, and
+  // tolerates the owner recycling them underneath the walk, as the flight
+  // recorder does. Each chunk is copied into |scratch|, which must hold
+  // TraceChunk::kCapacity slots, and its records are only visited if the
+  // chunk's sequence number stayed the same meanwhile. A chunk that was
+  // recycled is skipped. Doesn't allocate, so is safe in a signal handler.
+  template <typename Visitor>
+  void ForEachRecentRecord(size_t max_chunks,
+                           TraceSlot* scratch,
+                           Visitor visit) const {
+    const TraceChunk* chunk = head_.load(std::memory_order_acquire);
+    for (size_t n = 0; chunk && n < max_chunks; n++) {
+      uint64_t sequence = chunk->sequence.load(std::memory_order_acquire);
+      size_t committed = std::min(
+          chunk->committed.load(std::memory_order_acquire),
+          TraceChunk::kCapacity);
+      memcpy(scratch, chunk->slots, committed * sizeof(TraceSlot));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (chunk->sequence.load(std::memory_order_relaxed) == sequence)
+        ForEachRecordIn(scratch, committed, visit);
+      chunk = chunk->next.load(std::memory_order_acquire);
+    }
+  }
+
+  // Owning thread only. |weight| is the number of calls a sampled event
+  // stands for.
+  void RecordDuration(uint32_t frame, uint64_t duration, uint32_t weight) {
+    histograms_.Get(frame)->Record(duration, weight);
+  }
+
+  void RecordAllocations(uint32_t frame,
+                         const ThreadAllocationCounters& counters,
+                         uint32_t weight) {
+    allocations_.Get(frame)->Record(counters, weight);
+  }
+
+  void RecordPerfCounters(uint32_t frame,
+                          const uint64_t* deltas,
+                          size_t count,
+                          uint32_t weight) {
+    perf_counters_.Get(frame)->Record(deltas, count, weight);
+  }
+
+  const ThreadFrameTable<ThreadLatencyHistogram>& histograms() const {
+    return histograms_;
+  }
+
+  const ThreadFrameTable<ThreadAllocationStats>& allocations() const {
+    return allocations_;
+  }
+
+  const ThreadFrameTable<ThreadPerfCounterStats>& perf_counters() const {
+    return perf_counters_;
+  }
+
+  uint64_t thread_id() const { return thread_id_; }
+  const std::string& thread_name() const { return thread_name_; }
+
+  // Records appended so far, including those since dropped or overwritten.
+  uint64_t records() const { return records_.load(std::memory_order_relaxed); }
+
+  // The next buffer in the Tracer's lock-free list of every buffer.
+  const ThreadTraceBuffer* next_registered() const { return next_registered_; }
+
+ private:
+  friend class TraceSocketServer;
+  friend class TraceStreamer;
+  friend class ::base::Tracer;
+
+  // Returns |count| contiguous slots, starting a new chunk if the current one
+  // can't fit them. Nothing is visible to readers until Commit().
+  TraceSlot* Reserve(size_t count) {
+    if (size_ + count > TraceChunk::kCapacity)
+      NewChunk();
+    TraceSlot* slots = &tail_->slots[size_];
+    size_ += count;
+    return slots;
+  }
+
+  void Commit() {
+    tail_->committed.store(size_, std::memory_order_release);
+    records_.store(records_.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+  }
+
+  static void SetRecord(TraceSlot* slot,
+                        uint64_t timestamp,
+                        uint32_t frame,
+                        TraceRecord::Type type,
+                        size_t extra_slots) {
+    TraceRecord& record = slot->record;
+    record.timestamp = timestamp;
+    record.frame = static_cast<uint16_t>(frame);
+    record.type = type;
+    record.extra_slots = static_cast<uint8_t>(extra_slots);
+    record.arg_types = 0;
+  }
+
+  void NewChunk();
+
+  std::atomic<TraceChunk*> head_;
+  TraceChunk* tail_;
+  size_t size_ = 0;
+  size_t chunk_count_ = 1;
+  uint64_t chunk_sequence_ = 0;
+  std::atomic<uint64_t> records_ = 0;
+  const ThreadTraceBuffer* next_registered_ = nullptr;
+  ThreadFrameTable<ThreadLatencyHistogram> histograms_{kMaxTraceFrames};
+  ThreadFrameTable<ThreadAllocationStats> allocations_{kMaxTraceFrames};
+  ThreadFrameTable<ThreadPerfCounterStats> perf_counters_{kMaxTraceFrames};
+  const uint64_t thread_id_;
+  const std::string thread_name_;
+};
+
+// One per TRACE_EVENT call site. Constant initialized, so the function-local
+// static in the macro costs no guard. The category bit and frame id are looked
+// up the first time the site is hit while any category is enabled, and cached
+// here afterwards.
+class TraceSite {
+ public:
+  static constexpr uint32_t kDisabledFrame = UINT32_MAX;
+
+  constexpr TraceSite(const char* category, const char* name)
+      : category(category), name(name) {}
+
+  // The frame to record for this site, or kDisabledFrame if its category is
+  // off. When tracing is disabled this is one relaxed load of the enabled
+  // mask and one of the site's own category bit.
+  inline uint32_t EnabledFrame();
+
+  const char* const category;
+  const char* const name;
+
+ private:
+  void Resolve();
+
+  // All ones until resolved, so that the first hit with any category enabled
+  // takes the slow path.
+  std::atomic<uint64_t> category_bit_ = ~uint64_t{0};
+  std::atomic<uint32_t> frame_ = kDisabledFrame;
+};
+
+}  // namespace internal
+
+enum class TraceFormat {
+  kSpeedscope,
+  kChromeJson,
+  kPerfetto,
+};
+
 class Tracer {
  public:
   static Tracer* Get();
 
-  size_t StartEvent(std::string e);
-  void EndEvent(size_t id);
+  // At most this many categories get their own bit in the enabled mask; any
+  // further ones share the last bit. The top bit of the mask is set while an
+  // enabled category has not been seen yet, so that unresolved sites still
+  // take the slow path and find out whether they belong to it.
+  static constexpr size_t kMaxCategories = 63;
+
+  // Returns a stable id for |name| in |category|. Both must outlive the Tracer
+  // (in practice, string literals). Equal pairs share an id.
+  uint32_t InternFrame(const char* category, const char* name);
+  const char* FrameName(uint32_t frame) const;
+  const char* FrameCategory(uint32_t frame) const;
+  uint32_t FrameCount() const;
+
+  // Returns the bit for |category| in the enabled mask, registering it if it
+  // is new.
+  uint64_t CategoryBit(const char* category);
+
+  // Records exactly the categories named in |categories|, a comma separated
+  // list. "*" enables every category, "" disables tracing.
+  void SetEnabledCategories(std::string_view categories);
+
+  static uint64_t EnabledCategoryMask() {
+    return enabled_categories_.load(std::memory_order_relaxed);
+  }
+
+  // What a TRACE_EVENT does with its begin and end times. The timeline keeps
+  // every record; histograms keep only a per-name distribution of durations,
+  // in constant memory, and can stay on indefinitely.
+  // kRecordAllocations counts the operator new calls made directly inside
+  // each TRACE_EVENT, and kRecordPerfCounters reads the thread's
+  // PerfCounters around it. Either is added to the event's end record as
+  // arguments, and to a per-name summary.
+  enum RecordMode : uint32_t {
+    kRecordTimeline = 1 << 0,
+    kRecordHistograms = 1 << 1,
+    kRecordAllocations = 1 << 2,
+    kRecordPerfCounters = 1 << 3,
+  };
+
+  // Defaults to kRecordTimeline. Events already in progress finish in the
+  // mode they started in. kRecordAllocations is ignored unless
+  // //base/tracing:allocation_hooks is linked in, and kRecordPerfCounters if
+  // no perf counters can be opened.
+  void SetRecordModes(uint32_t modes);
+
+  static uint32_t RecordModes() {
+    return record_modes_.load(std::memory_order_relaxed);
+  }
+
+  // At most this many distinct policies; any further ones share the last.
+  static constexpr size_t kMaxSamplingGroups = 32;
+
+  // Records only some of the calls to the TRACE_EVENTs of |category|, or of
+  // |name| in |category|, which takes precedence. Every recorded event's
+  // end record gets a "sample_weight" argument with the number of calls it
+  // stands for, unless that is 1, and histograms and the other summaries
+  // count it that many times. SamplingPolicy::All() turns sampling back off.
+  // Instant, counter, async and flow events are never sampled.
+  void SetSampling(std::string_view category, const SamplingPolicy& policy);
+  void SetSampling(std::string_view category,
+                   std::string_view name,
+                   const SamplingPolicy& policy);
+
+  // How many calls the current call to a TRACE_EVENT of |frame| stands for,
+  // or 0 if it is to be skipped. Unsampled frames cost one relaxed load,
+  // skipped calls a thread local decrement.
+  static uint32_t SampleWeight(uint32_t frame) {
+    uint8_t group =
+        frame_sampling_groups_[frame].load(std::memory_order_relaxed);
+    if (__builtin_expect(!group, 1))
+      return 1;
+    SampleCountdown& countdown = sample_countdowns_[group];
+    if (countdown.remaining > 1) {
+      countdown.remaining--;
+      return 0;
+    }
+    return TakeSample(group);
+  }
+
+  static void StartEvent(uint32_t frame) {
+    StartEvent(frame, TraceClock::Now());
+  }
+
+  // |args| are key, value pairs; see TRACE_EVENT.
+  template <typename... Args>
+  static void StartEvent(uint32_t frame, uint64_t timestamp, Args&&... args) {
+    static_assert(sizeof...(Args) % 2 == 0,
+                  "Trace event arguments come in key, value pairs");
+    static_assert(sizeof...(Args) / 2 <= internal::TraceArg::kMaxArgs,
+                  "Too many trace event arguments");
+    if constexpr (sizeof...(Args) == 0) {
+      CurrentThreadBuffer()->Append(timestamp, frame,
+                                    internal::TraceRecord::kBegin);
+    } else {
+      CurrentThreadBuffer()->AppendWithArgs(
+          timestamp, frame, internal::TraceRecord::kBegin, args...);
+    }
+  }
+
+  static void EndEvent(uint32_t frame) { EndEvent(frame, TraceClock::Now()); }
+
+  template <typename... Args>
+  static void EndEvent(uint32_t frame, uint64_t timestamp, Args&&... args) {
+    if constexpr (sizeof...(Args) == 0) {
+      CurrentThreadBuffer()->Append(timestamp, frame,
+                                    internal::TraceRecord::kEnd);
+    } else {
+      CurrentThreadBuffer()->AppendWithArgs(
+          timestamp, frame, internal::TraceRecord::kEnd, args...);
+    }
+  }
 
+  // Records a single instant, counter, async or flow record. Used by the
+  // TRACE_INSTANT, TRACE_COUNTER, TRACE_ASYNC_* and TRACE_FLOW_* macros.
+  static void AddEvent(uint32_t frame, internal::TraceRecord::Type type) {
+    if (RecordModes() & kRecordTimeline)
+      CurrentThreadBuffer()->Append(TraceClock::Now(), frame, type);
+  }
+
+  static void AddEvent(uint32_t frame,
+                       internal::TraceRecord::Type type,
+                       uint64_t payload) {
+    if (RecordModes() & kRecordTimeline)
+      CurrentThreadBuffer()->Append(TraceClock::Now(), frame, type, payload);
+  }
+
+  static void RecordDuration(uint32_t frame,
+                             uint64_t duration,
+                             uint32_t weight = 1) {
+    CurrentThreadBuffer()->RecordDuration(frame, duration, weight);
+  }
+
+  static void EndEventWithUintArgs(uint32_t frame,
+                                   uint64_t timestamp,
+                                   const char* const* keys,
+                                   const uint64_t* values,
+                                   size_t count) {
+    CurrentThreadBuffer()->AppendWithUintArgs(
+        timestamp, frame, internal::TraceRecord::kEnd, keys, values, count);
+  }
+
+  static void RecordPerfCounters(uint32_t frame,
+                                 const uint64_t* deltas,
+                                 size_t count,
+                                 uint32_t weight = 1) {
+    CurrentThreadBuffer()->RecordPerfCounters(frame, deltas, count, weight);
+  }
+
+  static void RecordAllocations(
+      uint32_t frame,
+      const internal::ThreadAllocationCounters& counters,
+      uint32_t weight = 1) {
+    CurrentThreadBuffer()->RecordAllocations(frame, counters, weight);
+  }
+
+  // The durations recorded for |frame| on every thread so far.
+  LatencyHistogram GetHistogram(uint32_t frame);
+
+  // Like above, but by name. Empty if no such event was ever hit.
+  std::optional<LatencyHistogram> GetHistogram(std::string_view category,
+                                               std::string_view name);
+
+  // Every non-empty histogram, keyed by "category/name", as summarized by
+  // LatencyHistogram::ToJson().
+  json::Object DumpHistograms();
+
+  // What the events of |frame| allocated on every thread so far.
+  AllocationStats GetAllocationStats(uint32_t frame);
+
+  // Every frame's non-empty AllocationStats, keyed by "category/name".
+  json::Object DumpAllocations();
+
+  // The perf counter deltas of the events of |frame| on every thread so far.
+  PerfCounterStats GetPerfCounterStats(uint32_t frame);
+
+  // Every frame's non-empty PerfCounterStats, keyed by "category/name".
+  json::Object DumpPerfCounters();
+
+  // What tracing has cost so far. Exports include this as metadata: under
+  // "otherData" in Chrome JSON, "tracer_overhead" in speedscope, and as the
+  // arguments of a final "tracer_overhead" instant in Perfetto traces.
+  TracerOverhead Overhead() const;
+
+  // Enables every category and writes the trace as speedscope JSON to stdout
+  // when the Tracer is destroyed.
   void PrintOnExit();
 
+  // Writes the trace to |path| when the Tracer is destroyed.
+  void ExportOnExit(TraceFormat format, std::string path);
+
+  // Writes everything recorded so far. Threads may keep recording meanwhile,
+  // in the default mode and in flight recorder mode, and their later records
+  // are left out; so are records a flight recorder overwrites during the
+  // export. While streaming to a file the records belong to the stream, so
+  // nothing is written and this returns false.
+  bool Export(TraceFormat format, std::ostream& out);
+
+  // Switches to streaming mode: full chunks are handed to a background thread
+  // which appends them to |path| as Chrome trace-event JSON. At most
+  // |max_buffer_bytes| of chunks wait for the writer; beyond that, records are
+  // dropped and counted rather than blocking the recording thread. The file is
+  // completed when the Tracer is destroyed. Returns false if |path| can't be
+  // opened or a stream is already active.
+  bool StreamToFile(const std::string& path,
+                    size_t max_buffer_bytes = 16 * 1024 * 1024);
+
+  internal::TraceStreamer* streamer() const {
+    return streamer_.load(std::memory_order_acquire);
+  }
+
+  // Serves records to a consumer process on the Unix domain socket |path|,
+  // in the binary framing described in trace_socket.h, as they are made.
+  // Consumers may connect and disconnect at any time, one at a time. Returns
+  // false if |path| can't be bound, or if a socket is already being served or
+  // the trace is streaming to a file.
+  bool ServeOnSocket(const std::string& path);
+
+  // Switches to flight recorder mode: each thread keeps only its most recent
+  // |bytes_per_thread| of records, overwriting the oldest. A snapshot is
+  // written to "<path>.<pid>.<n>" on SIGUSR1, on a CHECK or MCHECK failure,
+  // and on SIGSEGV, SIGBUS, SIGILL, SIGFPE or SIGABRT. Returns false if
+  // streaming or the flight recorder is already active.
+  bool StartFlightRecorder(const std::string& path,
+                           size_t bytes_per_thread = 4 * 1024 * 1024);
+
+  // Number of chunks each thread keeps in flight recorder mode, or 0.
+  size_t ring_chunks() const {
+    return ring_chunks_.load(std::memory_order_relaxed);
+  }
+
+  // Every buffer ever registered, newest first. Safe to walk without locking,
+  // including from a signal handler.
+  const internal::ThreadTraceBuffer* registered_buffers() const {
+    return registered_buffers_.load(std::memory_order_acquire);
+  }
+
  private:
+  static constexpr size_t kMaxFrames = internal::kMaxTraceFrames;
+
   Tracer();
   ~Tracer();
 
-  bool print_ = false;
-  std::time_t initial_;
-  std::vector<std::string> frames_;
-  std::vector<std::tuple<bool, size_t, size_t>> events_;
+  static internal::ThreadTraceBuffer* CurrentThreadBuffer() {
+    if (!thread_buffer_)
+      thread_buffer_ = Get()->RegisterCurrentThread();
+    return thread_buffer_;
+  }
+
+  // A thread's position in the sampling interval of one group. |weight| is
+  // the number of calls the next sample will stand for.
+  struct SampleCountdown {
+    uint32_t remaining;
+    uint32_t weight;
+  };
+
+  static uint32_t TakeSample(uint8_t group);
+
+  // Measures TracerOverhead's per-record costs.
+  void Calibrate();
+
+  internal::ThreadTraceBuffer* RegisterCurrentThread();
+  void SetSamplingLocked(std::string key, const SamplingPolicy& policy);
+  uint8_t SamplingGroupLocked(std::string_view category,
+                              std::string_view name) const;
+  uint8_t CategoryIndexLocked(const char* category);
+  void UpdateEnabledMaskLocked();
+  void Export(
+      TraceFormat format,
+      const std::vector<std::unique_ptr<internal::ThreadTraceBuffer>>& buffers,
+      std::ostream& out);
+
+  std::optional<TraceFormat> exit_format_;
+  std::string exit_path_;
+
+  // Guards interning and |buffers_|. Never taken while recording an event.
+  std::mutex lock_;
+  std::map<std::pair<std::string_view, std::string_view>, uint32_t> frame_ids_;
+  bool enable_all_categories_ = false;
+  std::set<std::string, std::less<>> enabled_category_names_;
+  std::vector<std::unique_ptr<internal::ThreadTraceBuffer>> buffers_;
+  std::atomic<internal::TraceStreamer*> streamer_ = nullptr;
+  std::unique_ptr<internal::TraceSocketServer> socket_server_;
+  std::atomic<size_t> ring_chunks_ = 0;
+  std::atomic<const internal::ThreadTraceBuffer*> registered_buffers_ =
+      nullptr;
+
+  // What Overhead() reports: the per-record costs measured by Calibrate(),
+  // and the number and total duration of exports.
+  double clock_read_ns_ = 0;
+  double record_ns_ = 0;
+  std::atomic<uint64_t> exports_ = 0;
+  std::atomic<uint64_t> export_nanos_ = 0;
+  // When the export in progress started, or 0.
+  std::atomic<uint64_t> export_start_ = 0;
+
+  // Append-only; entries below |frame_count_| are never modified, so readers
+  // don't need |lock_|.
+  std::atomic<uint32_t> frame_count_ = 0;
+  const char* frames_[kMaxFrames];
+  uint8_t frame_categories_[kMaxFrames];
+  std::atomic<uint32_t> category_count_ = 0;
+  const char* categories_[kMaxCategories];
+
+  // Keyed by "category" or "category/name". Group 0 is never sampled.
+  std::map<std::string, uint8_t, std::less<>> sampling_group_ids_;
+
+  static inline std::atomic<uint64_t> enabled_categories_ = 0;
+  static inline std::atomic<uint32_t> record_modes_ = kRecordTimeline;
+  static inline internal::SamplingGroup sampling_groups_[kMaxSamplingGroups];
+  static inline std::atomic<uint8_t> frame_sampling_groups_[kMaxFrames] = {};
+  static inline thread_local SampleCountdown
+      sample_countdowns_[kMaxSamplingGroups] = {};
+
+  static inline thread_local internal::ThreadTraceBuffer* thread_buffer_ =
+      nullptr;
+};
+
+uint32_t internal::TraceSite::EnabledFrame() {
+  if (__builtin_expect(
+          !(Tracer::EnabledCategoryMask() &
+            category_bit_.load(std::memory_order_relaxed)),
+          1)) {
+    return kDisabledFrame;
+  }
+  uint32_t frame = frame_.load(std::memory_order_relaxed);
+  if (frame == kDisabledFrame) {
+    Resolve();
+    return EnabledFrame();
+  }
+  return frame;
+}
+
+namespace internal {
+
+// What an enabled TraceEvent needs to record its end. Kept apart from the
+// TraceEvent, so that a disabled one is only a frame id, and only filled in
+// for enabled events.
+struct TraceEventState {
+  uint32_t weight;
+  uint32_t modes;
+  uint64_t begin;
+  ThreadAllocationCounters saved_allocations;
+  // Whether |perf_counters| holds a reading to subtract from the end's.
+  bool perf_counters_read;
+  PerfCounters::Reading perf_counters;
+};
+
+// The states of the calling thread's enabled TraceEvents, innermost last.
+struct TraceEventStack {
+  // Enabled events nested deeper than this are skipped.
+  static constexpr size_t kMaxDepth = 64;
+
+  TraceEventState& top() { return states[depth - 1]; }
+
+  size_t depth = 0;
+  TraceEventState states[kMaxDepth];
 };
 
-template <typename T>
+inline thread_local TraceEventStack trace_event_stack = {};
+
+}  // namespace internal
+
+// Records a begin record in Begin() and the matching end record when it goes
+// out of scope, if the site's category is enabled. With histograms on, the
+// duration between the two is recorded as well. Begin() is separate so that
+// TRACE_EVENT only evaluates its arguments when the category is enabled.
 class TraceEvent {
  public:
-  TraceEvent(T&& t) { key_ = Tracer::Get()->StartEvent(t); }
+  explicit TraceEvent(internal::TraceSite* site)
+      : frame_(site->EnabledFrame()) {
+    if (frame_ != internal::TraceSite::kDisabledFrame)
+      Enter();
+  }
+
+  bool enabled() const { return frame_ != internal::TraceSite::kDisabledFrame; }
+
+  // Call once, if enabled(), with the site's name, which is already known,
+  // followed by the event's arguments.
+  template <typename... Args>
+  void Begin(const char*, Args&&... args) {
+    internal::TraceEventState& state = internal::trace_event_stack.top();
+    state.modes = Tracer::RecordModes();
+    if (state.modes & Tracer::kRecordAllocations)
+      state.saved_allocations = internal::thread_allocations;
+    state.begin = TraceClock::Now();
+    if (state.modes & Tracer::kRecordTimeline)
+      Tracer::StartEvent(frame_, state.begin, args...);
+    // After StartEvent(), so that the tracer's own work doesn't count.
+    if (state.modes & Tracer::kRecordAllocations)
+      internal::thread_allocations = {};
+    if (state.modes & Tracer::kRecordPerfCounters)
+      state.perf_counters_read = PerfCounters::Read(&state.perf_counters);
+  }
+
+  ~TraceEvent() {
+    if (frame_ != internal::TraceSite::kDisabledFrame)
+      End();
+  }
 
-  ~TraceEvent() { Tracer::Get()->EndEvent(key_); }
+  TraceEvent(const TraceEvent&) = delete;
+  TraceEvent& operator=(const TraceEvent&) = delete;
 
  private:
-  size_t key_;
+  // Samples the event and pushes its state, or disables the event if it is
+  // skipped or nested too deeply.
+  void Enter();
+  // Records the end of the event and pops its state.
+  void End();
+  // Ends with the metrics and sample weight as arguments.
+  void EndWithArgs(const internal::TraceEventState& state, uint64_t end);
+
+  uint32_t frame_;
 };
 
 }  // namespace base
 
-#define TRACE_EVENT(name) ::base::TraceEvent<std::string> __##NAME##__(#name);
+// A string literal TRACE_EVENT argument, kept by pointer instead of copied.
+#define TRACE_STR(literal) \
+  ::base::internal::TraceStaticString { "" literal }
+
+#define TRACE_INTERNAL_CONCAT_(a, b) a##b
+#define TRACE_INTERNAL_CONCAT(a, b) TRACE_INTERNAL_CONCAT_(a, b)
+
+#if defined(BASE_TRACING_DISABLED)
+
+#define TRACE_EVENT(category, ...) \
+  do {                             \
+  } while (0)
+#define TRACE_INSTANT(category, name) \
+  do {                                \
+  } while (0)
+#define TRACE_COUNTER(category, name, value) \
+  do {                                       \
+  } while (0)
+#define TRACE_ASYNC_BEGIN(category, name, id) \
+  do {                                        \
+  } while (0)
+#define TRACE_ASYNC_END(category, name, id) \
+  do {                                      \
+  } while (0)
+#define TRACE_FLOW_BEGIN(category, name, id) \
+  do {                                       \
+  } while (0)
+#define TRACE_FLOW_END(category, name, id) \
+  do {                                     \
+  } while (0)
+
+#else
+
+// The first of the arguments, of which there is at least one.
+#define TRACE_INTERNAL_FIRST(...) TRACE_INTERNAL_FIRST_(__VA_ARGS__, unused)
+#define TRACE_INTERNAL_FIRST_(first, ...) first
+
+#define TRACE_INTERNAL_EVENT(uid, category, ...)                              \
+  static ::base::internal::TraceSite TRACE_INTERNAL_CONCAT(trace_site_, uid)( \
+      "" category, "" TRACE_INTERNAL_FIRST(__VA_ARGS__));                     \
+  ::base::TraceEvent TRACE_INTERNAL_CONCAT(trace_event_, uid)(                \
+      &TRACE_INTERNAL_CONCAT(trace_site_, uid));                              \
+  if (TRACE_INTERNAL_CONCAT(trace_event_, uid).enabled())                     \
+    TRACE_INTERNAL_CONCAT(trace_event_, uid).Begin(__VA_ARGS__)
+
+// Traces the rest of the enclosing scope, if |category| is enabled:
+//
+//   TRACE_EVENT("net", "Fetch", "url", url, "bytes", body.size());
+//
+// |category| and |name| must be string literals. Up to eight key, value
+// arguments may follow; keys must be string literals, and values integers,
+// enums, doubles, bools or strings. Strings are copied, up to 64 characters,
+// except for string literals wrapped in TRACE_STR(), which are stored by
+// pointer:
+//
+//   TRACE_EVENT("net", "Connect", "proto", TRACE_STR("tcp"));
+//
+// Arguments are stored inline in the trace and only evaluated when
+// |category| is enabled.
+// Building with -DBASE_TRACING_DISABLED compiles every TRACE_EVENT out.
+#define TRACE_EVENT(category, ...) \
+  TRACE_INTERNAL_EVENT(__COUNTER__, category, __VA_ARGS__)
+
+// Evaluates its arguments only if |category| is enabled.
+#define TRACE_INTERNAL_ADD_EVENT(uid, category, name, ...)          \
+  do {                                                              \
+    static ::base::internal::TraceSite TRACE_INTERNAL_CONCAT(       \
+        trace_site_, uid)("" category, "" name);                    \
+    uint32_t trace_frame =                                          \
+        TRACE_INTERNAL_CONCAT(trace_site_, uid).EnabledFrame();     \
+    if (trace_frame != ::base::internal::TraceSite::kDisabledFrame) \
+      ::base::Tracer::AddEvent(trace_frame, __VA_ARGS__);           \
+  } while (0)
+
+#define TRACE_INTERNAL_RECORD_TYPE(type) ::base::internal::TraceRecord::type
+
+// A point in time on the current thread.
+#define TRACE_INSTANT(category, name)                   \
+  TRACE_INTERNAL_ADD_EVENT(__COUNTER__, category, name, \
+                           TRACE_INTERNAL_RECORD_TYPE(kInstant))
+
+// Sets the counter |name| to |value|, an integer, from now on. Counters are
+// per process; any thread may set them.
+#define TRACE_COUNTER(category, name, value)                     \
+  TRACE_INTERNAL_ADD_EVENT(__COUNTER__, category, name,          \
+                           TRACE_INTERNAL_RECORD_TYPE(kCounter), \
+                           static_cast<uint64_t>(static_cast<int64_t>(value)))
+
+// An operation that isn't bound to a thread's stack: it may end on another
+// thread, and may overlap with others of the same name as long as their
+// |id|s differ. Begin and end must use the same |category|, |name| and |id|.
+#define TRACE_ASYNC_BEGIN(category, name, id)                       \
+  TRACE_INTERNAL_ADD_EVENT(__COUNTER__, category, name,             \
+                           TRACE_INTERNAL_RECORD_TYPE(kAsyncBegin), \
+                           static_cast<uint64_t>(id))
+#define TRACE_ASYNC_END(category, name, id)                       \
+  TRACE_INTERNAL_ADD_EVENT(__COUNTER__, category, name,           \
+                           TRACE_INTERNAL_RECORD_TYPE(kAsyncEnd), \
+                           static_cast<uint64_t>(id))
+
+// Draws an arrow from the TRACE_EVENT enclosing TRACE_FLOW_BEGIN to the one
+// enclosing the TRACE_FLOW_END with the same |id|, typically on another
+// thread.
+#define TRACE_FLOW_BEGIN(category, name, id)                       \
+  TRACE_INTERNAL_ADD_EVENT(__COUNTER__, category, name,            \
+                           TRACE_INTERNAL_RECORD_TYPE(kFlowBegin), \
+                           static_cast<uint64_t>(id))
+#define TRACE_FLOW_END(category, name, id)                       \
+  TRACE_INTERNAL_ADD_EVENT(__COUNTER__, category, name,          \
+                           TRACE_INTERNAL_RECORD_TYPE(kFlowEnd), \
+                           static_cast<uint64_t>(id))
+
+#endif  // defined(BASE_TRACING_DISABLED)
 
-#endif  // BASE_TRACING_TRACE_H_
\ No newline at end of file
+#endif  // BASE_TRACING_TRACE_H_
@@ -0,0 +1,68 @@
+// Measures the cost of a TRACE_EVENT in each of the ways it can be recorded,
+// and prints the Tracer's own estimate of its overhead afterwards.
+
+#include <cstdint>
+#include <iostream>
+
+#include "base/benchmark.h"
+#include "base/json/json_io.h"
+#include "base/tracing/trace.h"
+
+namespace {
+
+// Not inlined, so that every mode pays for the same call.
+__attribute__((noinline)) void Untraced(int i) {
+  base::DoNotOptimize(i);
+}
+
+__attribute__((noinline)) void Traced(int i) {
+  TRACE_EVENT("benchmark", "Traced");
+  base::DoNotOptimize(i);
+}
+
+__attribute__((noinline)) void TracedWithArgs(int i) {
+  TRACE_EVENT("benchmark", "TracedWithArgs", "i", i, "name",
+              TRACE_STR("value"));
+  base::DoNotOptimize(i);
+}
+
+}  // namespace
+
+int main() {
+  base::Tracer* tracer = base::Tracer::Get();
+
+  // The cost of the call alone, for the disabled TRACE_EVENT to be compared
+  // against.
+  base::RunBenchmark("no TRACE_EVENT", Untraced);
+
+  tracer->SetEnabledCategories("");
+  base::RunBenchmark("disabled", Traced);
+
+  tracer->SetEnabledCategories("other");
+  base::RunBenchmark("other category enabled", Traced);
+
+  tracer->SetEnabledCategories("benchmark");
+  tracer->SetRecordModes(base::Tracer::kRecordTimeline);
+  base::RunBenchmark("timeline", Traced);
+  base::RunBenchmark("timeline, two args", TracedWithArgs);
+
+  tracer->SetRecordModes(base::Tracer::kRecordHistograms);
+  base::RunBenchmark("histograms", Traced);
+
+  tracer->SetRecordModes(base::Tracer::kRecordTimeline |
+                         base::Tracer::kRecordHistograms);
+  base::RunBenchmark("timeline and histograms", Traced);
+
+  tracer->SetSampling("benchmark", base::SamplingPolicy::OneIn(100));
+  base::RunBenchmark("sampled 1 in 100", Traced);
+
+  tracer->SetSampling("benchmark", base::SamplingPolicy::TargetRate(10000));
+  base::RunBenchmark("sampled at 10000/s", Traced);
+
+  tracer->SetSampling("benchmark", base::SamplingPolicy::All());
+  tracer->SetEnabledCategories("");
+
+  base::TracerOverhead overhead = tracer->Overhead();
+  std::cout << "\n" << overhead.ToJson() << "\n";
+  return 0;
+}
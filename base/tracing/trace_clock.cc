@@ -0,0 +1,59 @@
+#include "base/tracing/trace_clock.h"
+
+#include <mutex>
+
+#if BASE_TRACE_CLOCK_HAS_TSC
+#include <cpuid.h>
+#endif
+
+namespace base {
+
+namespace {
+
+// How long to spin while measuring the TSC frequency. Long enough that the
+// error of the two clock_gettime() calls is well under a part per million.
+constexpr uint64_t kCalibrationNanos = 10 * 1000 * 1000;
+
+#if BASE_TRACE_CLOCK_HAS_TSC
+bool HasInvariantTsc() {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007)
+    return false;
+  if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+    return false;
+  return edx & (1u << 8);
+}
+#endif
+
+}  // namespace
+
+TraceClock::State TraceClock::state_;
+
+// static
+void TraceClock::Initialize() {
+  static std::once_flag once;
+  std::call_once(once, []() {
+#if BASE_TRACE_CLOCK_HAS_TSC
+    if (HasInvariantTsc()) {
+      uint64_t mono_start = MonotonicNanos();
+      uint64_t tsc_start = __rdtsc();
+      uint64_t mono_end = mono_start;
+      while (mono_end - mono_start < kCalibrationNanos)
+        mono_end = MonotonicNanos();
+      uint64_t tsc_end = __rdtsc();
+      if (tsc_end > tsc_start) {
+        unsigned __int128 nanos = mono_end - mono_start;
+        state_.tsc_multiplier = static_cast<uint64_t>(
+            (nanos << kMultiplierShift) / (tsc_end - tsc_start));
+        state_.tsc_origin = tsc_end;
+        state_.monotonic_origin = mono_end;
+        state_.use_tsc = true;
+        return;
+      }
+    }
+#endif
+    state_.monotonic_origin = MonotonicNanos();
+  });
+}
+
+}  // namespace base
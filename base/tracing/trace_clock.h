@@ -0,0 +1,68 @@
+#ifndef BASE_TRACING_TRACE_CLOCK_H_
+#define BASE_TRACING_TRACE_CLOCK_H_
+
+#include <cstdint>
+#include <ctime>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BASE_TRACE_CLOCK_HAS_TSC 1
+#else
+#define BASE_TRACE_CLOCK_HAS_TSC 0
+#endif
+
+namespace base {
+
+// Monotonic, nanosecond resolution timestamps for trace events. When the CPU
+// advertises an invariant TSC, Now() is a single rdtsc scaled by a multiplier
+// calibrated against CLOCK_MONOTONIC in Initialize(). Otherwise it falls back
+// to clock_gettime(CLOCK_MONOTONIC).
+class TraceClock {
+ public:
+  // Picks the clock source and records the origin. Safe to call repeatedly;
+  // only the first call does any work.
+  static void Initialize();
+
+  // Nanoseconds since Initialize().
+  static uint64_t Now() {
+#if BASE_TRACE_CLOCK_HAS_TSC
+    if (state_.use_tsc) {
+      uint64_t ticks = __rdtsc() - state_.tsc_origin;
+      return static_cast<uint64_t>(
+          (static_cast<unsigned __int128>(ticks) * state_.tsc_multiplier) >>
+          kMultiplierShift);
+    }
+#endif
+    return MonotonicNanos() - state_.monotonic_origin;
+  }
+
+  // The CLOCK_MONOTONIC reading, in nanoseconds, at which Now() returned 0.
+  static uint64_t OriginMonotonicNanos() { return state_.monotonic_origin; }
+
+  static bool UsesTsc() { return state_.use_tsc; }
+
+  static uint64_t MonotonicNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull +
+           static_cast<uint64_t>(ts.tv_nsec);
+  }
+
+ private:
+  static constexpr unsigned kMultiplierShift = 32;
+
+  struct State {
+    bool use_tsc = false;
+    uint64_t tsc_origin = 0;
+    // Nanoseconds per tick, as a fixed point number with |kMultiplierShift|
+    // fractional bits.
+    uint64_t tsc_multiplier = 0;
+    uint64_t monotonic_origin = 0;
+  };
+
+  static State state_;
+};
+
+}  // namespace base
+
+#endif  // BASE_TRACING_TRACE_CLOCK_H_
@@ -0,0 +1,282 @@
+// Connects to a process serving its trace with Tracer::ServeOnSocket() and
+// writes what it receives to stdout as Chrome trace-event JSON, in the array
+// form that chrome://tracing and ui.perfetto.dev accept without a closing
+// bracket, so the output stays usable however the consumer is stopped.
+//
+//   trace_consumer /tmp/app.trace.sock > live.json
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "base/tracing/chrome_trace_writer.h"
+#include "base/tracing/trace_socket.h"
+
+namespace {
+
+using base::internal::TraceArg;
+using base::internal::TraceRecord;
+using base::internal::TraceSocketServer;
+
+// Reads the primitives of trace_socket.h's framing. Reading past the end
+// yields zeros and clears ok().
+class Reader {
+ public:
+  explicit Reader(std::string_view data) : data_(data) {}
+
+  bool ok() const { return ok_; }
+  bool done() const { return offset_ >= data_.size(); }
+
+  uint64_t VarInt() {
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      if (done()) {
+        ok_ = false;
+        return 0;
+      }
+      uint8_t byte = static_cast<uint8_t>(data_[offset_++]);
+      value |= uint64_t{byte & 0x7fu} << shift;
+      if (!(byte & 0x80))
+        return value;
+    }
+    ok_ = false;
+    return 0;
+  }
+
+  int64_t SignedVarInt() {
+    uint64_t value = VarInt();
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+  }
+
+  std::string_view String() {
+    uint64_t length = VarInt();
+    if (length > data_.size() - offset_) {
+      ok_ = false;
+      return {};
+    }
+    std::string_view value = data_.substr(offset_, length);
+    offset_ += length;
+    return value;
+  }
+
+  std::string_view Bytes(size_t length) {
+    if (length > data_.size() - offset_) {
+      ok_ = false;
+      return {};
+    }
+    std::string_view value = data_.substr(offset_, length);
+    offset_ += length;
+    return value;
+  }
+
+  double Double() {
+    std::string_view bytes = Bytes(8);
+    uint64_t bits = 0;
+    for (size_t i = 0; i < bytes.size(); i++)
+      bits |= uint64_t{static_cast<uint8_t>(bytes[i])} << (8 * i);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+ private:
+  std::string_view data_;
+  size_t offset_ = 0;
+  bool ok_ = true;
+};
+
+class Consumer {
+ public:
+  explicit Consumer(std::ostream& out) : out_(out) {}
+
+  // False if |body| is malformed.
+  bool HandleMessage(uint8_t type, std::string_view body) {
+    Reader in(body);
+    switch (type) {
+      case TraceSocketServer::kHello:
+        if (in.Bytes(4) != "btrc" ||
+            in.VarInt() != TraceSocketServer::kVersion) {
+          return false;
+        }
+        pid_ = in.VarInt();
+        out_ << "[\n";
+        break;
+      case TraceSocketServer::kThread: {
+        uint64_t tid = in.VarInt();
+        std::string_view name = in.String();
+        StartEvent("M", tid);
+        out_ << ",\"name\":\"thread_name\",\"args\":{\"name\":";
+        base::internal::WriteJsonString(out_, name);
+        out_ << "}},\n";
+        break;
+      }
+      case TraceSocketServer::kFrame: {
+        uint64_t frame = in.VarInt();
+        std::string_view category = in.String();
+        std::string_view name = in.String();
+        frames_[frame] = {std::string(category), std::string(name)};
+        break;
+      }
+      case TraceSocketServer::kRecords:
+        HandleRecords(in);
+        break;
+      case TraceSocketServer::kDropped:
+        std::cerr << "dropped " << in.VarInt() << " records\n";
+        break;
+      default:
+        break;
+    }
+    out_.flush();
+    return in.ok();
+  }
+
+ private:
+  void HandleRecords(Reader& in) {
+    uint64_t tid = in.VarInt();
+    uint64_t timestamp = 0;
+    while (in.ok() && !in.done()) {
+      uint32_t type = static_cast<uint32_t>(in.VarInt());
+      const auto& [category, name] = frames_[in.VarInt()];
+      timestamp += in.SignedVarInt();
+      char phase[2] = {base::internal::ChromeTracePhase(type), '\0'};
+      StartEvent(phase, tid);
+      out_ << ",\"ts\":" << timestamp / 1000 << '.';
+      char fraction[4];
+      snprintf(fraction, sizeof(fraction), "%03" PRIu64, timestamp % 1000);
+      out_ << fraction << ",\"name\":";
+      base::internal::WriteJsonString(out_, name);
+      if (type != TraceRecord::kEnd) {
+        out_ << ",\"cat\":";
+        base::internal::WriteJsonString(out_, category);
+      }
+      if (type == TraceRecord::kInstant)
+        out_ << ",\"s\":\"t\"";
+      if (type == TraceRecord::kFlowEnd)
+        out_ << ",\"bp\":\"e\"";
+      if (type == TraceRecord::kCounter) {
+        out_ << ",\"args\":{\"value\":" << static_cast<int64_t>(in.VarInt())
+             << "}";
+      } else if (type > TraceRecord::kCounter) {
+        char id[24];
+        snprintf(id, sizeof(id), "0x%" PRIx64, in.VarInt());
+        out_ << ",\"id\":\"" << id << "\"";
+      } else {
+        WriteArgs(in);
+      }
+      out_ << "},\n";
+    }
+  }
+
+  void WriteArgs(Reader& in) {
+    uint64_t count = in.VarInt();
+    if (!count)
+      return;
+    out_ << ",\"args\":{";
+    for (uint64_t i = 0; i < count && in.ok(); i++) {
+      if (i)
+        out_ << ",";
+      base::internal::WriteJsonString(out_, in.String());
+      out_ << ":";
+      switch (in.VarInt()) {
+        case TraceArg::kInt:
+          out_ << in.SignedVarInt();
+          break;
+        case TraceArg::kUint:
+          out_ << in.VarInt();
+          break;
+        case TraceArg::kDouble: {
+          double value = in.Double();
+          char number[32];
+          snprintf(number, sizeof(number), "%.17g", value);
+          out_ << (value - value == 0 ? number : "null");
+          break;
+        }
+        case TraceArg::kBool:
+          out_ << (in.VarInt() ? "true" : "false");
+          break;
+        case TraceArg::kString:
+        case TraceArg::kCopiedString:
+          base::internal::WriteJsonString(out_, in.String());
+          break;
+        default:
+          out_ << "null";
+          break;
+      }
+    }
+    out_ << "}";
+  }
+
+  void StartEvent(const char* phase, uint64_t tid) {
+    out_ << "{\"ph\":\"" << phase << "\",\"pid\":" << pid_
+         << ",\"tid\":" << tid;
+  }
+
+  std::ostream& out_;
+  uint64_t pid_ = 0;
+  std::map<uint64_t, std::pair<std::string, std::string>> frames_;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    std::cerr << "usage: " << argv[0] << " <socket path>\n";
+    return 2;
+  }
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, argv[1], sizeof(address.sun_path) - 1);
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0 || connect(fd, reinterpret_cast<struct sockaddr*>(&address),
+                        sizeof(address)) != 0) {
+    std::cerr << argv[1] << ": " << strerror(errno) << "\n";
+    return 1;
+  }
+
+  Consumer consumer(std::cout);
+  std::string buffer;
+  char data[64 * 1024];
+  while (true) {
+    ssize_t result = read(fd, data, sizeof(data));
+    if (result < 0 && errno == EINTR)
+      continue;
+    if (result <= 0)
+      break;
+    buffer.append(data, result);
+    // Handle every complete message, keeping any partial one for later.
+    size_t offset = 0;
+    while (offset < buffer.size()) {
+      Reader header(std::string_view(buffer).substr(offset + 1));
+      uint64_t length = header.VarInt();
+      if (!header.ok())
+        break;
+      size_t header_size = 1;
+      for (uint64_t rest = length; rest >= 0x80; rest >>= 7)
+        header_size++;
+      header_size++;
+      if (buffer.size() - offset < header_size + length)
+        break;
+      if (!consumer.HandleMessage(
+              static_cast<uint8_t>(buffer[offset]),
+              std::string_view(buffer).substr(offset + header_size, length))) {
+        std::cerr << "malformed message\n";
+        return 1;
+      }
+      offset += header_size + length;
+    }
+    buffer.erase(0, offset);
+  }
+  close(fd);
+  return 0;
+}
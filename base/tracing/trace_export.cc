@@ -0,0 +1,518 @@
+#include "base/tracing/trace_export.h"
+
+#include <unistd.h>
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <type_traits>
+
+#include "base/json/json.h"
+#include "base/json/json_io.h"
+#include "base/tracing/chrome_trace_writer.h"
+#include "base/tracing/proto_writer.h"
+#include "base/tracing/trace_clock.h"
+
+namespace base {
+namespace internal {
+
+namespace {
+
+// Calls |visit(record, extra)| on each of |buffer|'s records. In flight
+// recorder mode the owning thread recycles chunks while they're read, so each
+// is copied first and left out if it was recycled meanwhile.
+template <typename Visitor>
+void ForEachExportedRecord(const Tracer* tracer,
+                           const ThreadTraceBuffer& buffer,
+                           Visitor visit) {
+  if (size_t ring_chunks = tracer->ring_chunks()) {
+    auto scratch = std::make_unique<TraceSlot[]>(TraceChunk::kCapacity);
+    buffer.ForEachRecentRecord(ring_chunks + 1, scratch.get(), visit);
+  } else {
+    buffer.ForEachRecord(visit);
+  }
+}
+
+json::JSON SpeedscopeProfile(const Tracer* tracer,
+                             const ThreadTraceBuffer& buffer) {
+  std::map<std::string, json::JSON> profile_map;
+  profile_map.insert({"type", "evented"});
+  profile_map.insert({"name", buffer.thread_name() + " (" +
+                                  std::to_string(buffer.thread_id()) + ")"});
+  profile_map.insert({"unit", "nanoseconds"});
+  ssize_t start_value = -1;
+  ssize_t end_value = 0;
+  std::vector<json::JSON> events;
+  // Speedscope only has stacks; anything that isn't a TRACE_EVENT is left out.
+  ForEachExportedRecord(tracer, buffer, [&](const TraceRecord& record,
+                                             const TraceSlot*) {
+    if (record.type != TraceRecord::kBegin && record.type != TraceRecord::kEnd)
+      return;
+    ssize_t at = static_cast<ssize_t>(record.timestamp);
+    if (start_value == -1)
+      start_value = at;
+    end_value = at;
+    std::map<std::string, json::JSON> blob;
+    blob.insert({"type", record.type == TraceRecord::kBegin ? "O" : "C"});
+    blob.insert({"frame", static_cast<ssize_t>(record.frame)});
+    blob.insert({"at", at});
+    events.emplace_back(std::move(blob));
+  });
+  profile_map.insert({"startValue", std::max<ssize_t>(start_value, 0)});
+  profile_map.insert({"endValue", end_value});
+  profile_map.insert({"events", std::move(events)});
+  return json::Object(std::move(profile_map));
+}
+
+// Field numbers from perfetto/protos/perfetto/trace/.
+namespace proto {
+constexpr uint32_t kTracePacket = 1;
+
+constexpr uint32_t kPacketClockSnapshot = 6;
+constexpr uint32_t kPacketTimestamp = 8;
+constexpr uint32_t kPacketSequenceId = 10;
+constexpr uint32_t kPacketTrackEvent = 11;
+constexpr uint32_t kPacketInternedData = 12;
+constexpr uint32_t kPacketSequenceFlags = 13;
+constexpr uint32_t kPacketTimestampClockId = 58;
+constexpr uint32_t kPacketDefaults = 59;
+constexpr uint32_t kPacketTrackDescriptor = 60;
+
+constexpr uint32_t kSequenceIncrementalStateCleared = 1;
+constexpr uint32_t kSequenceNeedsIncrementalState = 2;
+
+constexpr uint32_t kClockSnapshotClocks = 1;
+constexpr uint32_t kClockId = 1;
+constexpr uint32_t kClockTimestamp = 2;
+constexpr uint32_t kClockIsIncremental = 3;
+constexpr uint32_t kBuiltinClockMonotonic = 3;
+// Sequence scoped clock ids start at 64.
+constexpr uint32_t kIncrementalClock = 64;
+
+constexpr uint32_t kDefaultsTrackEventDefaults = 11;
+constexpr uint32_t kDefaultsTimestampClockId = 58;
+constexpr uint32_t kTrackEventDefaultsTrackUuid = 11;
+
+constexpr uint32_t kTrackDescriptorUuid = 1;
+constexpr uint32_t kTrackDescriptorProcess = 3;
+constexpr uint32_t kTrackDescriptorThread = 4;
+constexpr uint32_t kTrackDescriptorParentUuid = 5;
+constexpr uint32_t kTrackDescriptorName = 2;
+constexpr uint32_t kTrackDescriptorCounter = 8;
+constexpr uint32_t kProcessPid = 1;
+constexpr uint32_t kThreadPid = 1;
+constexpr uint32_t kThreadTid = 2;
+constexpr uint32_t kThreadName = 5;
+
+constexpr uint32_t kTrackEventCategoryIids = 3;
+constexpr uint32_t kTrackEventCategories = 22;
+constexpr uint32_t kTrackEventName = 23;
+constexpr uint32_t kTrackEventDebugAnnotations = 4;
+constexpr uint32_t kTrackEventType = 9;
+constexpr uint32_t kTrackEventNameIid = 10;
+constexpr uint32_t kTrackEventTrackUuid = 11;
+constexpr uint32_t kTrackEventCounterValue = 30;
+constexpr uint32_t kTrackEventFlowIds = 47;
+constexpr uint32_t kTrackEventTerminatingFlowIds = 48;
+constexpr uint32_t kTypeSliceBegin = 1;
+constexpr uint32_t kTypeSliceEnd = 2;
+constexpr uint32_t kTypeInstant = 3;
+constexpr uint32_t kTypeCounter = 4;
+
+constexpr uint32_t kDebugAnnotationBoolValue = 2;
+constexpr uint32_t kDebugAnnotationUintValue = 3;
+constexpr uint32_t kDebugAnnotationIntValue = 4;
+constexpr uint32_t kDebugAnnotationDoubleValue = 5;
+constexpr uint32_t kDebugAnnotationStringValue = 6;
+constexpr uint32_t kDebugAnnotationName = 10;
+
+constexpr uint32_t kInternedEventCategories = 1;
+constexpr uint32_t kInternedEventNames = 2;
+constexpr uint32_t kEventCategoryIid = 1;
+constexpr uint32_t kEventCategoryName = 2;
+constexpr uint32_t kEventNameIid = 1;
+constexpr uint32_t kEventNameName = 2;
+}  // namespace proto
+
+class PerfettoSequence {
+ public:
+  PerfettoSequence(const Tracer* tracer,
+                   const ThreadTraceBuffer& buffer,
+                   uint32_t sequence_id,
+                   uint64_t process_uuid,
+                   std::set<uint64_t>* described_tracks,
+                   ProtoWriter* trace,
+                   std::ostream& out)
+      : tracer_(tracer),
+        buffer_(buffer),
+        sequence_id_(sequence_id),
+        process_uuid_(process_uuid),
+        track_uuid_(process_uuid ^ (buffer.thread_id() << 32) ^
+                    buffer.thread_id()),
+        described_tracks_(described_tracks),
+        trace_(trace),
+        out_(out) {}
+
+  void Write() {
+    bool started = false;
+    auto visit = [this, &started](const TraceRecord& record,
+                                  const TraceSlot* extra) {
+      uint64_t timestamp =
+          TraceClock::OriginMonotonicNanos() + record.timestamp;
+      if (!started) {
+        WriteSequenceStart(timestamp);
+        started = true;
+      }
+      WriteRecord(record, extra, timestamp);
+    };
+    ForEachExportedRecord(tracer_, buffer_, visit);
+  }
+
+ private:
+  void WriteSequenceStart(uint64_t timestamp) {
+    packet_.Clear();
+    packet_.AppendVarInt(proto::kPacketTimestamp, timestamp);
+    packet_.AppendVarInt(proto::kPacketTimestampClockId,
+                         proto::kBuiltinClockMonotonic);
+    packet_.AppendVarInt(proto::kPacketSequenceId, sequence_id_);
+    packet_.AppendVarInt(proto::kPacketSequenceFlags,
+                         proto::kSequenceIncrementalStateCleared);
+    size_t defaults = packet_.BeginNested(proto::kPacketDefaults);
+    packet_.AppendVarInt(proto::kDefaultsTimestampClockId,
+                         proto::kIncrementalClock);
+    size_t track_defaults =
+        packet_.BeginNested(proto::kDefaultsTrackEventDefaults);
+    packet_.AppendVarInt(proto::kTrackEventDefaultsTrackUuid, track_uuid_);
+    packet_.EndNested(track_defaults);
+    packet_.EndNested(defaults);
+    size_t snapshot = packet_.BeginNested(proto::kPacketClockSnapshot);
+    size_t monotonic = packet_.BeginNested(proto::kClockSnapshotClocks);
+    packet_.AppendVarInt(proto::kClockId, proto::kBuiltinClockMonotonic);
+    packet_.AppendVarInt(proto::kClockTimestamp, timestamp);
+    packet_.EndNested(monotonic);
+    size_t incremental = packet_.BeginNested(proto::kClockSnapshotClocks);
+    packet_.AppendVarInt(proto::kClockId, proto::kIncrementalClock);
+    packet_.AppendVarInt(proto::kClockTimestamp, timestamp);
+    packet_.AppendBool(proto::kClockIsIncremental, true);
+    packet_.EndNested(incremental);
+    packet_.EndNested(snapshot);
+    FlushPacket();
+    last_timestamp_ = timestamp;
+
+    packet_.AppendVarInt(proto::kPacketSequenceId, sequence_id_);
+    size_t track = packet_.BeginNested(proto::kPacketTrackDescriptor);
+    packet_.AppendVarInt(proto::kTrackDescriptorUuid, track_uuid_);
+    packet_.AppendVarInt(proto::kTrackDescriptorParentUuid, process_uuid_);
+    size_t thread = packet_.BeginNested(proto::kTrackDescriptorThread);
+    packet_.AppendVarInt(proto::kThreadPid, process_uuid_);
+    packet_.AppendVarInt(proto::kThreadTid, buffer_.thread_id());
+    packet_.AppendString(proto::kThreadName, buffer_.thread_name());
+    packet_.EndNested(thread);
+    packet_.EndNested(track);
+    FlushPacket();
+  }
+
+  void WriteRecord(const TraceRecord& record,
+                   const TraceSlot* extra,
+                   uint64_t timestamp) {
+    uint64_t payload = RecordPayload(record, extra);
+    // Counters and async slices live on tracks of their own, which need
+    // describing before their first event.
+    uint64_t track_uuid = 0;
+    if (record.type == TraceRecord::kCounter) {
+      track_uuid = TrackUuid(kCounterTrack, record.frame);
+      DescribeTrack(track_uuid, record.frame, /*counter=*/true);
+    } else if (record.type == TraceRecord::kAsyncBegin ||
+               record.type == TraceRecord::kAsyncEnd) {
+      track_uuid = TrackUuid(kAsyncTrack, payload);
+      DescribeTrack(track_uuid, record.frame, /*counter=*/false);
+    }
+
+    packet_.AppendVarInt(proto::kPacketTimestamp, timestamp - last_timestamp_);
+    last_timestamp_ = timestamp;
+    packet_.AppendVarInt(proto::kPacketSequenceId, sequence_id_);
+    packet_.AppendVarInt(proto::kPacketSequenceFlags,
+                         proto::kSequenceNeedsIncrementalState);
+
+    event_.Clear();
+    switch (record.type) {
+      case TraceRecord::kBegin:
+      case TraceRecord::kAsyncBegin:
+        event_.AppendVarInt(proto::kTrackEventType, proto::kTypeSliceBegin);
+        InternNameAndCategory(record.frame);
+        break;
+      case TraceRecord::kEnd:
+      case TraceRecord::kAsyncEnd:
+        event_.AppendVarInt(proto::kTrackEventType, proto::kTypeSliceEnd);
+        break;
+      case TraceRecord::kInstant:
+      case TraceRecord::kFlowBegin:
+      case TraceRecord::kFlowEnd:
+        event_.AppendVarInt(proto::kTrackEventType, proto::kTypeInstant);
+        InternNameAndCategory(record.frame);
+        break;
+      case TraceRecord::kCounter:
+        event_.AppendVarInt(proto::kTrackEventType, proto::kTypeCounter);
+        event_.AppendSignedVarInt(proto::kTrackEventCounterValue,
+                                  static_cast<int64_t>(payload));
+        break;
+    }
+    if (track_uuid)
+      event_.AppendVarInt(proto::kTrackEventTrackUuid, track_uuid);
+    ForEachTraceArg(record, extra, [this](const TraceArg& arg,
+                                          TraceArg::Type type,
+                                          std::string_view string) {
+      WriteDebugAnnotation(arg, type, string);
+    });
+    if (record.type == TraceRecord::kFlowBegin)
+      event_.AppendFixed64(proto::kTrackEventFlowIds, payload);
+    if (record.type == TraceRecord::kFlowEnd)
+      event_.AppendFixed64(proto::kTrackEventTerminatingFlowIds, payload);
+    packet_.AppendString(proto::kPacketTrackEvent, event_.data());
+    FlushPacket();
+  }
+
+  void WriteDebugAnnotation(const TraceArg& arg,
+                            TraceArg::Type type,
+                            std::string_view string) {
+    size_t annotation = event_.BeginNested(proto::kTrackEventDebugAnnotations);
+    event_.AppendString(proto::kDebugAnnotationName, arg.key);
+    switch (type) {
+      case TraceArg::kNone:
+        break;
+      case TraceArg::kInt:
+        event_.AppendSignedVarInt(proto::kDebugAnnotationIntValue,
+                                  arg.int_value);
+        break;
+      case TraceArg::kUint:
+        event_.AppendVarInt(proto::kDebugAnnotationUintValue, arg.uint_value);
+        break;
+      case TraceArg::kDouble:
+        event_.AppendDouble(proto::kDebugAnnotationDoubleValue,
+                            arg.double_value);
+        break;
+      case TraceArg::kBool:
+        event_.AppendBool(proto::kDebugAnnotationBoolValue, arg.bool_value);
+        break;
+      case TraceArg::kString:
+      case TraceArg::kCopiedString:
+        event_.AppendString(proto::kDebugAnnotationStringValue, string);
+        break;
+    }
+    event_.EndNested(annotation);
+  }
+
+  // Adds the name and category ids of |frame| to |event_|, and their strings
+  // to |packet_|'s interned data the first time they're used.
+  void InternNameAndCategory(uint32_t frame) {
+    const char* category = tracer_->FrameCategory(frame);
+    auto category_iid = category_iids_.find(category);
+    bool new_category = category_iid == category_iids_.end();
+    if (new_category) {
+      category_iid =
+          category_iids_.emplace(category, category_iids_.size() + 1).first;
+    }
+    if (frame >= interned_.size())
+      interned_.resize(frame + 1, false);
+    bool new_name = !interned_[frame];
+    interned_[frame] = true;
+
+    event_.AppendVarInt(proto::kTrackEventCategoryIids, category_iid->second);
+    event_.AppendVarInt(proto::kTrackEventNameIid, frame + 1);
+    if (!new_category && !new_name)
+      return;
+    size_t interned = packet_.BeginNested(proto::kPacketInternedData);
+    if (new_category) {
+      size_t entry = packet_.BeginNested(proto::kInternedEventCategories);
+      packet_.AppendVarInt(proto::kEventCategoryIid, category_iid->second);
+      packet_.AppendString(proto::kEventCategoryName, category);
+      packet_.EndNested(entry);
+    }
+    if (new_name) {
+      size_t entry = packet_.BeginNested(proto::kInternedEventNames);
+      packet_.AppendVarInt(proto::kEventNameIid, frame + 1);
+      packet_.AppendString(proto::kEventNameName, tracer_->FrameName(frame));
+      packet_.EndNested(entry);
+    }
+    packet_.EndNested(interned);
+  }
+
+  enum TrackKind : uint64_t {
+    kCounterTrack = 1,
+    kAsyncTrack = 2,
+  };
+
+  // A process scoped track uuid for |key|, which can't collide with another
+  // kind of track or, in practice, with a thread track.
+  uint64_t TrackUuid(TrackKind kind, uint64_t key) const {
+    return Mix(Mix(process_uuid_ ^ Mix(key)) + kind);
+  }
+
+  static uint64_t Mix(uint64_t value) {
+    // splitmix64's finalizer.
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+    return value ^ (value >> 31);
+  }
+
+  void DescribeTrack(uint64_t uuid, uint32_t frame, bool counter) {
+    if (!described_tracks_->insert(uuid).second)
+      return;
+    packet_.AppendVarInt(proto::kPacketSequenceId, sequence_id_);
+    size_t track = packet_.BeginNested(proto::kPacketTrackDescriptor);
+    packet_.AppendVarInt(proto::kTrackDescriptorUuid, uuid);
+    packet_.AppendVarInt(proto::kTrackDescriptorParentUuid, process_uuid_);
+    packet_.AppendString(proto::kTrackDescriptorName,
+                         tracer_->FrameName(frame));
+    if (counter)
+      packet_.EndNested(packet_.BeginNested(proto::kTrackDescriptorCounter));
+    packet_.EndNested(track);
+    FlushPacket();
+  }
+
+  // Moves the finished packet into the trace, and the trace into |out_| once
+  // enough has built up.
+  void FlushPacket() {
+    trace_->AppendString(proto::kTracePacket, packet_.data());
+    packet_.Clear();
+    if (trace_->size() >= (1 << 20)) {
+      out_.write(trace_->data().data(), trace_->size());
+      trace_->Clear();
+    }
+  }
+
+  const Tracer* tracer_;
+  const ThreadTraceBuffer& buffer_;
+  const uint32_t sequence_id_;
+  const uint64_t process_uuid_;
+  const uint64_t track_uuid_;
+  // Counter and async tracks described so far, shared between sequences.
+  std::set<uint64_t>* described_tracks_;
+  ProtoWriter* trace_;
+  std::ostream& out_;
+
+  ProtoWriter packet_;
+  ProtoWriter event_;
+  uint64_t last_timestamp_ = 0;
+  std::vector<bool> interned_;
+  std::map<const char*, uint64_t> category_iids_;
+};
+
+// A process scoped instant with |overhead| as its arguments, stamped with the
+// current time on a sequence of its own.
+void WriteOverheadPacket(const TracerOverhead& overhead,
+                         uint64_t process_uuid,
+                         uint32_t sequence_id,
+                         ProtoWriter* trace) {
+  ProtoWriter event;
+  event.AppendVarInt(proto::kTrackEventType, proto::kTypeInstant);
+  event.AppendVarInt(proto::kTrackEventTrackUuid, process_uuid);
+  event.AppendString(proto::kTrackEventCategories, "tracer");
+  event.AppendString(proto::kTrackEventName, "tracer_overhead");
+  auto annotate = [&event](const char* name, auto value) {
+    size_t annotation = event.BeginNested(proto::kTrackEventDebugAnnotations);
+    event.AppendString(proto::kDebugAnnotationName, name);
+    if constexpr (std::is_floating_point_v<decltype(value)>)
+      event.AppendDouble(proto::kDebugAnnotationDoubleValue, value);
+    else
+      event.AppendVarInt(proto::kDebugAnnotationUintValue, value);
+    event.EndNested(annotation);
+  };
+  annotate("clock_read_ns", overhead.clock_read_ns);
+  annotate("record_ns", overhead.record_ns);
+  annotate("records", overhead.records);
+  annotate("recording_ns", overhead.recording_ns());
+  annotate("buffer_bytes", overhead.buffer_bytes);
+  annotate("exports", overhead.exports);
+  annotate("export_ns", overhead.export_ns);
+
+  ProtoWriter packet;
+  packet.AppendVarInt(proto::kPacketTimestamp,
+                      TraceClock::OriginMonotonicNanos() + TraceClock::Now());
+  packet.AppendVarInt(proto::kPacketTimestampClockId,
+                      proto::kBuiltinClockMonotonic);
+  packet.AppendVarInt(proto::kPacketSequenceId, sequence_id);
+  packet.AppendString(proto::kPacketTrackEvent, event.data());
+  trace->AppendString(proto::kTracePacket, packet.data());
+}
+
+}  // namespace
+
+void WriteSpeedscope(const Tracer* tracer,
+                     const ThreadTraceBuffers& buffers,
+                     std::ostream& out) {
+  std::map<std::string, json::JSON> schema;
+  schema.insert({"exporter", "base/trace"});
+  schema.insert({"name", "trace.json"});
+  schema.insert({"activeProfileIndex", 0});
+  schema.insert(
+      {"$schema", "https://www.speedscope.app/file-format-schema.json"});
+
+  std::map<std::string, json::JSON> shared;
+  std::vector<json::JSON> frames;
+  uint32_t frame_count = tracer->FrameCount();
+  for (uint32_t i = 0; i < frame_count; i++) {
+    std::map<std::string, json::JSON> blob;
+    blob.insert({"name", std::string(tracer->FrameName(i))});
+    frames.emplace_back(std::move(blob));
+  }
+  shared.insert({"frames", std::move(frames)});
+  schema.insert({"shared", std::move(shared)});
+
+  std::vector<json::JSON> profiles;
+  for (const auto& buffer : buffers)
+    profiles.push_back(SpeedscopeProfile(tracer, *buffer));
+  schema.insert({"profiles", std::move(profiles)});
+  schema.insert({"tracer_overhead", tracer->Overhead().ToJson()});
+
+  json::Object report(std::move(schema));
+  out << report << "\n";
+}
+
+void WriteChromeJson(const Tracer* tracer,
+                     const ThreadTraceBuffers& buffers,
+                     std::ostream& out) {
+  ChromeTraceWriter writer(tracer, out);
+  writer.WriteHeader();
+  for (const auto& buffer : buffers) {
+    ForEachExportedRecord(
+        tracer, *buffer,
+        [&writer, &buffer](const TraceRecord& record, const TraceSlot* extra) {
+          writer.WriteRecord(buffer->thread_id(), record, extra);
+        });
+    writer.WriteThreadName(buffer->thread_id(), buffer->thread_name());
+  }
+  std::map<std::string, json::JSON> other_data;
+  other_data.insert({"tracer_overhead", tracer->Overhead().ToJson()});
+  writer.WriteFooter(json::Object(std::move(other_data)));
+}
+
+void WritePerfetto(const Tracer* tracer,
+                   const ThreadTraceBuffers& buffers,
+                   std::ostream& out) {
+  ProtoWriter trace;
+  uint64_t pid = static_cast<uint64_t>(getpid());
+  {
+    ProtoWriter packet;
+    size_t track = packet.BeginNested(proto::kPacketTrackDescriptor);
+    packet.AppendVarInt(proto::kTrackDescriptorUuid, pid);
+    size_t process = packet.BeginNested(proto::kTrackDescriptorProcess);
+    packet.AppendVarInt(proto::kProcessPid, pid);
+    packet.EndNested(process);
+    packet.EndNested(track);
+    trace.AppendString(proto::kTracePacket, packet.data());
+  }
+  uint32_t sequence_id = 1;
+  std::set<uint64_t> described_tracks;
+  for (const auto& buffer : buffers) {
+    PerfettoSequence(tracer, *buffer, sequence_id++, pid, &described_tracks,
+                     &trace, out)
+        .Write();
+  }
+  WriteOverheadPacket(tracer->Overhead(), pid, sequence_id, &trace);
+  out.write(trace.data().data(), trace.size());
+}
+
+}  // namespace internal
+}  // namespace base
@@ -0,0 +1,36 @@
+#ifndef BASE_TRACING_TRACE_EXPORT_H_
+#define BASE_TRACING_TRACE_EXPORT_H_
+
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "base/tracing/trace.h"
+
+namespace base {
+namespace internal {
+
+using ThreadTraceBuffers = std::vector<std::unique_ptr<ThreadTraceBuffer>>;
+
+// https://www.speedscope.app/file-format-schema.json, one evented profile per
+// thread.
+void WriteSpeedscope(const Tracer* tracer,
+                     const ThreadTraceBuffers& buffers,
+                     std::ostream& out);
+
+// The Chrome trace-event JSON format, as loaded by chrome://tracing and
+// ui.perfetto.dev.
+void WriteChromeJson(const Tracer* tracer,
+                     const ThreadTraceBuffers& buffers,
+                     std::ostream& out);
+
+// A binary perfetto.protos.Trace. Each thread is its own packet sequence with
+// interned event names and delta encoded timestamps.
+void WritePerfetto(const Tracer* tracer,
+                   const ThreadTraceBuffers& buffers,
+                   std::ostream& out);
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_TRACING_TRACE_EXPORT_H_
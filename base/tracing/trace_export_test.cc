@@ -0,0 +1,295 @@
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "base/tracing/trace.h"
+#include "gtest/gtest.h"
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  base::Tracer::Get()->SetEnabledCategories("export_test");
+  return RUN_ALL_TESTS();
+}
+
+namespace base {
+namespace {
+
+std::string Export(TraceFormat format) {
+  std::ostringstream out;
+  EXPECT_TRUE(Tracer::Get()->Export(format, out));
+  return out.str();
+}
+
+// The lines of a Chrome JSON export that contain |needle|.
+std::vector<std::string> LinesWith(const std::string& json,
+                                   std::string_view needle) {
+  std::vector<std::string> lines;
+  std::istringstream in(json);
+  for (std::string line; std::getline(in, line);) {
+    if (line.find(needle) != std::string::npos)
+      lines.push_back(line);
+  }
+  return lines;
+}
+
+// Just enough of the protobuf wire format to check what the Perfetto
+// exporter wrote.
+struct ProtoField {
+  uint32_t number;
+  uint32_t wire_type;
+  uint64_t value;
+  std::string_view bytes;
+};
+
+bool ReadVarInt(std::string_view& data, uint64_t* value) {
+  *value = 0;
+  for (int shift = 0; shift < 64 && !data.empty(); shift += 7) {
+    uint8_t byte = data[0];
+    data.remove_prefix(1);
+    *value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+// Fails the test if |data| isn't a well formed message.
+std::vector<ProtoField> ParseMessage(std::string_view data) {
+  std::vector<ProtoField> fields;
+  while (!data.empty()) {
+    uint64_t tag;
+    ProtoField field = {};
+    if (!ReadVarInt(data, &tag)) {
+      ADD_FAILURE() << "truncated tag";
+      return {};
+    }
+    field.number = static_cast<uint32_t>(tag >> 3);
+    field.wire_type = tag & 7;
+    bool ok = true;
+    switch (field.wire_type) {
+      case 0:
+        ok = ReadVarInt(data, &field.value);
+        break;
+      case 1:
+        ok = data.size() >= 8;
+        if (ok) {
+          for (int i = 0; i < 8; i++) {
+            field.value |= static_cast<uint64_t>(static_cast<uint8_t>(data[i]))
+                           << (8 * i);
+          }
+          data.remove_prefix(8);
+        }
+        break;
+      case 2:
+        ok = ReadVarInt(data, &field.value) && field.value <= data.size();
+        if (ok) {
+          field.bytes = data.substr(0, field.value);
+          data.remove_prefix(field.value);
+        }
+        break;
+      default:
+        ok = false;
+    }
+    if (!ok) {
+      ADD_FAILURE() << "malformed field " << field.number;
+      return {};
+    }
+    fields.push_back(field);
+  }
+  return fields;
+}
+
+const ProtoField* FindField(const std::vector<ProtoField>& fields,
+                            uint32_t number) {
+  for (const ProtoField& field : fields) {
+    if (field.number == number)
+      return &field;
+  }
+  return nullptr;
+}
+
+// A TrackEvent, with its name resolved through the interned data.
+struct PerfettoEvent {
+  uint64_t type;
+  std::string name;
+  // Debug annotations, with values as text.
+  std::map<std::string, std::string> args;
+};
+
+// The track events of a Perfetto export, in order.
+std::vector<PerfettoEvent> ParsePerfetto(std::string_view trace) {
+  std::vector<PerfettoEvent> events;
+  // Interned names by sequence and iid.
+  std::map<std::pair<uint64_t, uint64_t>, std::string> names;
+  for (const ProtoField& packet_field : ParseMessage(trace)) {
+    EXPECT_EQ(packet_field.number, 1u);
+    EXPECT_EQ(packet_field.wire_type, 2u);
+    std::vector<ProtoField> packet = ParseMessage(packet_field.bytes);
+    const ProtoField* sequence = FindField(packet, 10);
+    uint64_t sequence_id = sequence ? sequence->value : 0;
+    if (const ProtoField* interned = FindField(packet, 12)) {
+      for (const ProtoField& entry : ParseMessage(interned->bytes)) {
+        if (entry.number != 2)
+          continue;
+        std::vector<ProtoField> name = ParseMessage(entry.bytes);
+        const ProtoField* iid = FindField(name, 1);
+        const ProtoField* text = FindField(name, 2);
+        if (iid && text)
+          names[{sequence_id, iid->value}] = std::string(text->bytes);
+      }
+    }
+    const ProtoField* track_event = FindField(packet, 11);
+    if (!track_event)
+      continue;
+    PerfettoEvent event = {};
+    for (const ProtoField& field : ParseMessage(track_event->bytes)) {
+      if (field.number == 9) {
+        event.type = field.value;
+      } else if (field.number == 10) {
+        event.name = names[{sequence_id, field.value}];
+      } else if (field.number == 23) {
+        event.name = std::string(field.bytes);
+      } else if (field.number == 4) {
+        std::vector<ProtoField> annotation = ParseMessage(field.bytes);
+        const ProtoField* key = FindField(annotation, 10);
+        if (!key)
+          continue;
+        std::string value;
+        for (const ProtoField& part : annotation) {
+          if (part.number == 6)
+            value = std::string(part.bytes);
+          else if (part.number != 10)
+            value = std::to_string(part.value);
+        }
+        event.args[std::string(key->bytes)] = value;
+      }
+    }
+    events.push_back(std::move(event));
+  }
+  return events;
+}
+
+TEST(TraceExportTest, ChromeJsonNestsEvents) {
+  {
+    TRACE_EVENT("export_test", "ChromeOuter", "count", 3, "ratio", 0.5);
+    TRACE_EVENT("export_test", "ChromeInner", "ok", true);
+  }
+  std::string json = Export(TraceFormat::kChromeJson);
+  EXPECT_EQ(json.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 0),
+            0u);
+  EXPECT_NE(json.find("],\"otherData\":{"), std::string::npos);
+
+  std::vector<std::string> outer = LinesWith(json, "\"name\":\"ChromeOuter\"");
+  std::vector<std::string> inner = LinesWith(json, "\"name\":\"ChromeInner\"");
+  ASSERT_EQ(outer.size(), 2u);
+  ASSERT_EQ(inner.size(), 2u);
+  EXPECT_NE(outer[0].find("\"ph\":\"B\""), std::string::npos);
+  EXPECT_NE(outer[0].find("\"cat\":\"export_test\""), std::string::npos);
+  EXPECT_NE(outer[0].find("\"args\":{\"count\":3,\"ratio\":0.5}"),
+            std::string::npos);
+  EXPECT_NE(inner[0].find("\"args\":{\"ok\":true}"), std::string::npos);
+  EXPECT_NE(outer[1].find("\"ph\":\"E\""), std::string::npos);
+  EXPECT_NE(inner[1].find("\"ph\":\"E\""), std::string::npos);
+  // B outer, B inner, E inner, E outer.
+  size_t begin_outer = json.find(outer[0]);
+  size_t begin_inner = json.find(inner[0]);
+  size_t end_inner = json.find(inner[1]);
+  size_t end_outer = json.find(outer[1]);
+  EXPECT_LT(begin_outer, begin_inner);
+  EXPECT_LT(begin_inner, end_inner);
+  EXPECT_LT(end_inner, end_outer);
+}
+
+TEST(TraceExportTest, ChromeJsonInstantsCountersAndFlows) {
+  TRACE_INSTANT("export_test", "ChromeInstant");
+  TRACE_COUNTER("export_test", "ChromeCounter", -7);
+  TRACE_ASYNC_BEGIN("export_test", "ChromeAsync", 0x2a);
+  TRACE_FLOW_END("export_test", "ChromeFlow", 0x2b);
+  std::string json = Export(TraceFormat::kChromeJson);
+
+  std::vector<std::string> instant = LinesWith(json, "ChromeInstant");
+  ASSERT_EQ(instant.size(), 1u);
+  EXPECT_NE(instant[0].find("\"ph\":\"i\",\"pid\""), std::string::npos);
+  EXPECT_NE(instant[0].find("\"s\":\"t\""), std::string::npos);
+
+  std::vector<std::string> counter = LinesWith(json, "ChromeCounter");
+  ASSERT_EQ(counter.size(), 1u);
+  EXPECT_NE(counter[0].find("\"ph\":\"C\""), std::string::npos);
+  EXPECT_NE(counter[0].find("\"args\":{\"value\":-7}"), std::string::npos);
+
+  std::vector<std::string> async = LinesWith(json, "ChromeAsync");
+  ASSERT_EQ(async.size(), 1u);
+  EXPECT_NE(async[0].find("\"ph\":\"b\""), std::string::npos);
+  EXPECT_NE(async[0].find("\"id\":\"0x2a\""), std::string::npos);
+
+  std::vector<std::string> flow = LinesWith(json, "ChromeFlow");
+  ASSERT_EQ(flow.size(), 1u);
+  EXPECT_NE(flow[0].find("\"ph\":\"f\""), std::string::npos);
+  EXPECT_NE(flow[0].find("\"bp\":\"e\",\"id\":\"0x2b\""), std::string::npos);
+}
+
+TEST(TraceExportTest, ChromeJsonEscapesStrings) {
+  std::string quoted = "say \"hi\"\n";
+  { TRACE_EVENT("export_test", "ChromeEscaped", "text", quoted); }
+  std::string json = Export(TraceFormat::kChromeJson);
+  std::vector<std::string> lines = LinesWith(json, "ChromeEscaped");
+  ASSERT_EQ(lines.size(), 2u);
+  EXPECT_NE(lines[0].find("\"text\":\"say \\\"hi\\\"\\n\""),
+            std::string::npos);
+}
+
+TEST(TraceExportTest, StringArraysAreCopied) {
+  char buffer[] = "before";
+  { TRACE_EVENT("export_test", "ChromeArray", "text", buffer); }
+  memcpy(buffer, "after!", sizeof(buffer));
+  std::vector<std::string> lines =
+      LinesWith(Export(TraceFormat::kChromeJson), "ChromeArray");
+  ASSERT_EQ(lines.size(), 2u);
+  EXPECT_NE(lines[0].find("\"text\":\"before\""), std::string::npos);
+}
+
+TEST(TraceExportTest, PerfettoRecordsSlicesWithInternedNames) {
+  {
+    TRACE_EVENT("export_test", "PerfettoOuter", "count", 3, "proto",
+                TRACE_STR("tcp"));
+    TRACE_EVENT("export_test", "PerfettoInner");
+  }
+  { TRACE_EVENT("export_test", "PerfettoOuter", "count", 4); }
+  std::string trace = Export(TraceFormat::kPerfetto);
+  std::vector<PerfettoEvent> events = ParsePerfetto(trace);
+
+  size_t first = 0;
+  while (first < events.size() && events[first].name != "PerfettoOuter")
+    first++;
+  ASSERT_LE(first + 6, events.size());
+  const PerfettoEvent* event = &events[first];
+  EXPECT_EQ(event[0].type, 1u);
+  EXPECT_EQ(event[0].args.at("count"), "3");
+  EXPECT_EQ(event[0].args.at("proto"), "tcp");
+  EXPECT_EQ(event[1].type, 1u);
+  EXPECT_EQ(event[1].name, "PerfettoInner");
+  EXPECT_EQ(event[2].type, 2u);
+  EXPECT_EQ(event[3].type, 2u);
+  EXPECT_EQ(event[4].type, 1u);
+  EXPECT_EQ(event[4].name, "PerfettoOuter");
+  EXPECT_EQ(event[4].args.at("count"), "4");
+  EXPECT_EQ(event[5].type, 2u);
+  // Both PerfettoOuters refer to one interned name.
+  EXPECT_EQ(trace.find("PerfettoOuter"), trace.rfind("PerfettoOuter"));
+}
+
+TEST(TraceExportTest, PerfettoEndsWithTracerOverhead) {
+  std::vector<PerfettoEvent> events = ParsePerfetto(
+      Export(TraceFormat::kPerfetto));
+  ASSERT_FALSE(events.empty());
+  EXPECT_EQ(events.back().name, "tracer_overhead");
+  EXPECT_EQ(events.back().type, 3u);
+  EXPECT_EQ(events.back().args.count("record_ns"), 1u);
+}
+
+}  // namespace
+}  // namespace base
@@ -0,0 +1,226 @@
+#ifndef BASE_TRACING_TRACE_RECORD_H_
+#define BASE_TRACING_TRACE_RECORD_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+namespace base {
+namespace internal {
+
+// The first slot of every event in a TraceChunk. Whatever else the event
+// carries lives in the |extra_slots| slots right after it, in the same chunk.
+struct TraceRecord {
+  enum Type : uint8_t {
+    kBegin = 0,
+    kEnd = 1,
+    kInstant = 2,
+    // Types from here on carry one extra slot holding a payload: the value
+    // for counters, the id for async and flow events.
+    kCounter = 3,
+    kAsyncBegin = 4,
+    kAsyncEnd = 5,
+    kFlowBegin = 6,
+    kFlowEnd = 7,
+  };
+
+  uint64_t timestamp;
+  uint16_t frame;
+  uint8_t type;
+  uint8_t extra_slots;
+  // The TraceArg::Type of each of a kBegin or kEnd record's arguments, four
+  // bits apiece, first argument lowest.
+  uint32_t arg_types;
+};
+
+// One TRACE_EVENT argument. The characters of a copied string follow in the
+// slots after it.
+struct TraceArg {
+  enum Type : uint8_t {
+    kNone = 0,
+    kInt = 1,
+    kUint = 2,
+    kDouble = 3,
+    kBool = 4,
+    kString = 5,
+    kCopiedString = 6,
+  };
+
+  static constexpr size_t kMaxArgs = 8;
+  // Longer strings are truncated.
+  static constexpr size_t kMaxCopiedLength = 64;
+
+  const char* key;
+  union {
+    int64_t int_value;
+    uint64_t uint_value;
+    double double_value;
+    bool bool_value;
+    const char* string_value;
+    size_t copied_length;
+  };
+};
+
+union TraceSlot {
+  TraceRecord record;
+  TraceArg arg;
+  uint64_t payload;
+  char chars[16];
+};
+
+static_assert(sizeof(TraceSlot) == 16, "Keep slots small");
+
+// The value of a counter or the id of an async or flow event, else 0.
+inline uint64_t RecordPayload(const TraceRecord& record,
+                              const TraceSlot* extra) {
+  return record.type >= TraceRecord::kCounter && record.extra_slots
+             ? extra->payload
+             : 0;
+}
+
+// Calls |visit(record, extra)| for each event in |slots|, where |extra|
+// points at the slots following |record|.
+template <typename Visitor>
+void ForEachRecordIn(const TraceSlot* slots, size_t count, Visitor& visit) {
+  for (size_t i = 0; i < count; i += 1 + slots[i].record.extra_slots) {
+    const TraceRecord& record = slots[i].record;
+    if (i + 1 + record.extra_slots > count)
+      break;
+    visit(record, slots + i + 1);
+  }
+}
+
+// The number of events in |slots|, as opposed to the slots they take up.
+inline size_t CountRecordsIn(const TraceSlot* slots, size_t count) {
+  size_t records = 0;
+  auto visit = [&records](const TraceRecord&, const TraceSlot*) { records++; };
+  ForEachRecordIn(slots, count, visit);
+  return records;
+}
+
+// Calls |visit(arg, type, string)| for each argument of |record|, where
+// |string| is the value of kString and kCopiedString arguments.
+template <typename Visitor>
+void ForEachTraceArg(const TraceRecord& record,
+                     const TraceSlot* extra,
+                     Visitor visit) {
+  if (record.type != TraceRecord::kBegin && record.type != TraceRecord::kEnd)
+    return;
+  size_t slot = 0;
+  for (size_t i = 0; i < TraceArg::kMaxArgs && slot < record.extra_slots;
+       i++) {
+    auto type = static_cast<TraceArg::Type>((record.arg_types >> (4 * i)) & 15);
+    if (type == TraceArg::kNone)
+      return;
+    const TraceArg& arg = extra[slot++].arg;
+    std::string_view string;
+    if (type == TraceArg::kString) {
+      string = arg.string_value;
+    } else if (type == TraceArg::kCopiedString) {
+      size_t length = std::min(arg.copied_length, TraceArg::kMaxCopiedLength);
+      size_t slots = (length + sizeof(TraceSlot) - 1) / sizeof(TraceSlot);
+      if (slot + slots > record.extra_slots)
+        return;
+      string = std::string_view(reinterpret_cast<const char*>(extra + slot),
+                                length);
+      slot += slots;
+    }
+    visit(arg, type, string);
+  }
+}
+
+// A string argument that is kept by pointer rather than copied, since it lives
+// as long as the program. Made by TRACE_STR(), from a string literal.
+struct TraceStaticString {
+  const char* value;
+};
+
+// Encoding of TRACE_EVENT argument values. Strings are copied into the
+// record, since by export time a pointer to a character array may dangle;
+// only TraceStaticStrings are kept by pointer, like event names.
+template <typename T>
+using TraceArgValue = std::remove_cv_t<std::remove_reference_t<T>>;
+
+template <typename T>
+std::string_view TraceArgCopiedString(const T& value) {
+  if constexpr (std::is_array_v<T>)
+    return std::string_view(value, strnlen(value, std::extent_v<T>));
+  else if constexpr (std::is_pointer_v<T>)
+    return value ? std::string_view(value) : std::string_view();
+  else
+    return std::string_view(value);
+}
+
+template <typename T>
+size_t TraceArgSlots(T&& value) {
+  using Value = TraceArgValue<T>;
+  if constexpr (std::is_same_v<Value, TraceStaticString> ||
+                std::is_arithmetic_v<Value> || std::is_enum_v<Value>) {
+    return 1;
+  } else {
+    size_t length = std::min(TraceArgCopiedString(value).size(),
+                             TraceArg::kMaxCopiedLength);
+    return 1 + (length + sizeof(TraceSlot) - 1) / sizeof(TraceSlot);
+  }
+}
+
+template <typename T>
+TraceArg::Type WriteTraceArg(TraceSlot* slot, const char* key, T&& value) {
+  using Value = TraceArgValue<T>;
+  TraceArg& arg = slot->arg;
+  arg.key = key;
+  if constexpr (std::is_same_v<Value, TraceStaticString>) {
+    arg.string_value = value.value;
+    return TraceArg::kString;
+  } else if constexpr (std::is_same_v<Value, bool>) {
+    arg.bool_value = value;
+    return TraceArg::kBool;
+  } else if constexpr (std::is_floating_point_v<Value>) {
+    arg.double_value = value;
+    return TraceArg::kDouble;
+  } else if constexpr (std::is_enum_v<Value>) {
+    arg.int_value = static_cast<int64_t>(value);
+    return TraceArg::kInt;
+  } else if constexpr (std::is_integral_v<Value> && std::is_signed_v<Value>) {
+    arg.int_value = value;
+    return TraceArg::kInt;
+  } else if constexpr (std::is_integral_v<Value>) {
+    arg.uint_value = value;
+    return TraceArg::kUint;
+  } else {
+    std::string_view string = TraceArgCopiedString(value);
+    arg.copied_length = std::min(string.size(), TraceArg::kMaxCopiedLength);
+    memcpy(slot + 1, string.data(), arg.copied_length);
+    return TraceArg::kCopiedString;
+  }
+}
+
+inline size_t CountTraceArgSlots() {
+  return 0;
+}
+
+template <typename Value, typename... Rest>
+size_t CountTraceArgSlots(const char*, Value&& value, Rest&&... rest) {
+  return TraceArgSlots(value) + CountTraceArgSlots(rest...);
+}
+
+inline void WriteTraceArgs(TraceSlot*, uint32_t*, size_t) {}
+
+template <typename Value, typename... Rest>
+void WriteTraceArgs(TraceSlot* slot,
+                    uint32_t* types,
+                    size_t index,
+                    const char* key,
+                    Value&& value,
+                    Rest&&... rest) {
+  *types |= uint32_t{WriteTraceArg(slot, key, value)} << (4 * index);
+  WriteTraceArgs(slot + TraceArgSlots(value), types, index + 1, rest...);
+}
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_TRACING_TRACE_RECORD_H_
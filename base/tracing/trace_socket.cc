@@ -0,0 +1,354 @@
+#include "base/tracing/trace_socket.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+namespace base {
+namespace internal {
+
+namespace {
+
+void AppendVarInt(std::string* out, uint64_t value) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+void AppendSignedVarInt(std::string* out, int64_t value) {
+  AppendVarInt(out, (static_cast<uint64_t>(value) << 1) ^
+                        static_cast<uint64_t>(value >> 63));
+}
+
+void AppendString(std::string* out, std::string_view value) {
+  AppendVarInt(out, value.size());
+  out->append(value);
+}
+
+void AppendDouble(std::string* out, double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  for (int i = 0; i < 8; i++)
+    out->push_back(static_cast<char>(bits >> (8 * i)));
+}
+
+}  // namespace
+
+// static
+std::unique_ptr<TraceSocketServer> TraceSocketServer::Create(
+    const Tracer* tracer,
+    const std::string& path) {
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address.sun_path))
+    return nullptr;
+  memcpy(address.sun_path, path.data(), path.size());
+
+  // Replace a socket left behind by an earlier process, but nothing else.
+  struct stat existing;
+  if (stat(path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode))
+    unlink(path.c_str());
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return nullptr;
+  if (bind(fd, reinterpret_cast<struct sockaddr*>(&address),
+           sizeof(address)) != 0 ||
+      listen(fd, 4) != 0) {
+    close(fd);
+    return nullptr;
+  }
+  return std::unique_ptr<TraceSocketServer>(
+      new TraceSocketServer(tracer, fd, path));
+}
+
+TraceSocketServer::TraceSocketServer(const Tracer* tracer,
+                                     int listen_fd,
+                                     std::string path)
+    : tracer_(tracer), listen_fd_(listen_fd), path_(std::move(path)) {
+  if (pipe2(stop_fds_, O_CLOEXEC) != 0)
+    stop_fds_[0] = stop_fds_[1] = -1;
+  thread_ = std::thread(&TraceSocketServer::Run, this);
+}
+
+TraceSocketServer::~TraceSocketServer() {
+  char stop = 0;
+  while (write(stop_fds_[1], &stop, 1) < 0 && errno == EINTR) {
+  }
+  thread_.join();
+  Detach();
+  close(stop_fds_[0]);
+  close(stop_fds_[1]);
+  close(listen_fd_);
+  unlink(path_.c_str());
+}
+
+void TraceSocketServer::Run() {
+  while (true) {
+    bool connected = consumer_fd_ >= 0;
+    struct pollfd fds[2] = {
+        {stop_fds_[0], POLLIN, 0},
+        {connected ? consumer_fd_ : listen_fd_, POLLIN, 0},
+    };
+    if (connected && pending_offset_ < pending_.size())
+      fds[1].events |= POLLOUT;
+    // With nobody connected there's nothing to send, so sleep until someone
+    // connects or the server stops.
+    if (poll(fds, 2, connected ? kPollIntervalMs : -1) < 0 && errno != EINTR)
+      return;
+    if (fds[0].revents)
+      return;
+
+    if (!connected) {
+      if (fds[1].revents & POLLIN) {
+        int fd = accept4(listen_fd_, nullptr, nullptr,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd >= 0)
+          Attach(fd);
+      }
+      continue;
+    }
+
+    // Consumers have nothing to say; reading only notices them leaving.
+    if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+      char ignored[256];
+      ssize_t result = recv(consumer_fd_, ignored, sizeof(ignored), 0);
+      if (result == 0 ||
+          (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+           errno != EINTR)) {
+        Detach();
+        continue;
+      }
+    }
+    SendNewRecords();
+    if (!Flush())
+      Detach();
+  }
+}
+
+void TraceSocketServer::Attach(int fd) {
+  consumer_fd_ = fd;
+  pending_.clear();
+  pending_offset_ = 0;
+  sent_frames_.clear();
+  positions_.clear();
+  // Start from what's being recorded now, not from the beginning.
+  for (const ThreadTraceBuffer* buffer = tracer_->registered_buffers(); buffer;
+       buffer = buffer->next_registered()) {
+    SkipToEnd(*buffer, positions_[buffer]);
+  }
+  dropped_ = 0;
+
+  body_.assign("btrc");
+  AppendVarInt(&body_, kVersion);
+  AppendVarInt(&body_, static_cast<uint64_t>(getpid()));
+  AppendMessage(kHello, body_);
+}
+
+void TraceSocketServer::Detach() {
+  if (consumer_fd_ < 0)
+    return;
+  close(consumer_fd_);
+  consumer_fd_ = -1;
+  pending_.clear();
+  pending_offset_ = 0;
+}
+
+void TraceSocketServer::SendNewRecords() {
+  for (const ThreadTraceBuffer* buffer = tracer_->registered_buffers(); buffer;
+       buffer = buffer->next_registered()) {
+    auto [it, inserted] = positions_.try_emplace(buffer);
+    Position& position = it->second;
+    if (inserted) {
+      // A thread that started recording since the consumer connected.
+      position.chunk = buffer->head_.load(std::memory_order_acquire);
+      position.sequence = position.chunk->sequence.load(
+          std::memory_order_acquire);
+    }
+    if (pending_.size() - pending_offset_ >= kMaxPendingBytes)
+      SkipToEnd(*buffer, position);
+    else
+      SendRecords(*buffer, position);
+  }
+  if (dropped_) {
+    body_.clear();
+    AppendVarInt(&body_, dropped_);
+    AppendMessage(kDropped, body_);
+    dropped_ = 0;
+  }
+}
+
+void TraceSocketServer::SendRecords(const ThreadTraceBuffer& buffer,
+                                    Position& position) {
+  if (!position.announced) {
+    body_.clear();
+    AppendVarInt(&body_, buffer.thread_id());
+    AppendString(&body_, buffer.thread_name());
+    AppendMessage(kThread, body_);
+    position.announced = true;
+  }
+
+  body_.clear();
+  AppendVarInt(&body_, buffer.thread_id());
+  size_t header_size = body_.size();
+  uint64_t last_timestamp = 0;
+  auto visit = [this, &position, &last_timestamp](const TraceRecord& record,
+                                                   const TraceSlot* extra) {
+    EncodeRecord(record, extra, &last_timestamp);
+    position.records++;
+  };
+  while (true) {
+    // A chunk may be recycled by the flight recorder while it's being read.
+    // Its sequence number changes first, so a copy taken while it stayed the
+    // same is consistent.
+    const TraceChunk* chunk = position.chunk;
+    uint64_t sequence = chunk->sequence.load(std::memory_order_acquire);
+    // The owner has finished with a chunk once it links the next one.
+    const TraceChunk* next = chunk->next.load(std::memory_order_acquire);
+    size_t committed =
+        std::min(chunk->committed.load(std::memory_order_acquire),
+                 TraceChunk::kCapacity);
+    if (sequence != position.sequence || committed < position.index) {
+      SkipToEnd(buffer, position);
+      break;
+    }
+    scratch_.assign(chunk->slots + position.index, chunk->slots + committed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (chunk->sequence.load(std::memory_order_relaxed) != sequence) {
+      SkipToEnd(buffer, position);
+      break;
+    }
+    ForEachRecordIn(scratch_.data(), scratch_.size(), visit);
+    position.index = committed;
+    if (!next)
+      break;
+    // Don't chase a thread that records faster than this one can encode.
+    if (pending_.size() - pending_offset_ + body_.size() >= kMaxPendingBytes) {
+      SkipToEnd(buffer, position);
+      break;
+    }
+    position.chunk = next;
+    position.sequence = next->sequence.load(std::memory_order_acquire);
+    position.index = 0;
+  }
+  if (body_.size() > header_size)
+    AppendMessage(kRecords, body_);
+}
+
+void TraceSocketServer::EncodeRecord(const TraceRecord& record,
+                                     const TraceSlot* extra,
+                                     uint64_t* last_timestamp) {
+  if (record.frame >= sent_frames_.size())
+    sent_frames_.resize(record.frame + 1, false);
+  if (!sent_frames_[record.frame]) {
+    // Goes out ahead of the kRecords message being built in |body_|.
+    std::string frame;
+    AppendVarInt(&frame, record.frame);
+    AppendString(&frame, tracer_->FrameCategory(record.frame));
+    AppendString(&frame, tracer_->FrameName(record.frame));
+    AppendMessage(kFrame, frame);
+    sent_frames_[record.frame] = true;
+  }
+
+  AppendVarInt(&body_, record.type);
+  AppendVarInt(&body_, record.frame);
+  AppendSignedVarInt(&body_,
+                     static_cast<int64_t>(record.timestamp - *last_timestamp));
+  *last_timestamp = record.timestamp;
+  if (record.type >= TraceRecord::kCounter) {
+    AppendVarInt(&body_, RecordPayload(record, extra));
+    return;
+  }
+
+  std::string args;
+  size_t count = 0;
+  ForEachTraceArg(record, extra, [&args, &count](const TraceArg& arg,
+                                                 TraceArg::Type type,
+                                                 std::string_view string) {
+    count++;
+    AppendString(&args, arg.key);
+    AppendVarInt(&args, type);
+    switch (type) {
+      case TraceArg::kNone:
+        break;
+      case TraceArg::kInt:
+        AppendSignedVarInt(&args, arg.int_value);
+        break;
+      case TraceArg::kUint:
+        AppendVarInt(&args, arg.uint_value);
+        break;
+      case TraceArg::kDouble:
+        AppendDouble(&args, arg.double_value);
+        break;
+      case TraceArg::kBool:
+        AppendVarInt(&args, arg.bool_value);
+        break;
+      case TraceArg::kString:
+      case TraceArg::kCopiedString:
+        AppendString(&args, string);
+        break;
+    }
+  });
+  AppendVarInt(&body_, count);
+  body_.append(args);
+}
+
+void TraceSocketServer::SkipToEnd(const ThreadTraceBuffer& buffer,
+                                  Position& position) {
+  uint64_t records = buffer.records();
+  const TraceChunk* chunk = buffer.head_.load(std::memory_order_acquire);
+  while (const TraceChunk* next = chunk->next.load(std::memory_order_acquire))
+    chunk = next;
+  position.chunk = chunk;
+  position.sequence = chunk->sequence.load(std::memory_order_acquire);
+  position.index = std::min(chunk->committed.load(std::memory_order_acquire),
+                            TraceChunk::kCapacity);
+  if (records > position.records)
+    dropped_ += records - position.records;
+  position.records = records;
+}
+
+void TraceSocketServer::AppendMessage(MessageType type, std::string_view body) {
+  pending_.push_back(static_cast<char>(type));
+  AppendVarInt(&pending_, body.size());
+  pending_.append(body);
+}
+
+bool TraceSocketServer::Flush() {
+  while (pending_offset_ < pending_.size()) {
+    ssize_t result =
+        send(consumer_fd_, pending_.data() + pending_offset_,
+             pending_.size() - pending_offset_, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (result > 0) {
+      pending_offset_ += result;
+    } else if (result < 0 && errno == EINTR) {
+      continue;
+    } else if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    } else {
+      return false;
+    }
+  }
+  if (pending_offset_ == pending_.size()) {
+    pending_.clear();
+    pending_offset_ = 0;
+  } else if (pending_offset_ >= pending_.size() / 2) {
+    pending_.erase(0, pending_offset_);
+    pending_offset_ = 0;
+  }
+  return true;
+}
+
+}  // namespace internal
+}  // namespace base
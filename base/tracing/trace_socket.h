@@ -0,0 +1,123 @@
+#ifndef BASE_TRACING_TRACE_SOCKET_H_
+#define BASE_TRACING_TRACE_SOCKET_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "base/tracing/trace.h"
+
+namespace base {
+namespace internal {
+
+// Serves live trace records to one consumer process at a time over a Unix
+// domain socket. Recording threads never take part: a background thread polls
+// every thread's buffer for records committed since it last looked and sends
+// them in batches. So with no consumer connected tracing costs nothing extra,
+// and a consumer that can't keep up loses records, which are counted, rather
+// than holding anyone up. A consumer only sees records made after it connects.
+//
+// The stream is a series of messages: a one byte MessageType, the length of
+// the body as a varint, and the body. Integers are LEB128 varints, zigzag
+// encoded if signed; strings are a varint length and the bytes; doubles are
+// eight little-endian bytes.
+//
+//   kHello    "btrc", kVersion, pid
+//   kThread   tid, name                   before a thread's first records
+//   kFrame    frame, category, name       before a frame's first record
+//   kRecords  tid, then until the end of the body one record after another:
+//               TraceRecord::Type, frame,
+//               timestamp in TraceClock nanoseconds, signed, as the
+//                 difference from the previous record in the message,
+//               payload, for types from kCounter on,
+//               argument count, then per argument its key, TraceArg::Type
+//                 and value (kString and kCopiedString are both strings)
+//   kDropped  records lost since the last kDropped
+class TraceSocketServer {
+ public:
+  enum MessageType : uint8_t {
+    kHello = 1,
+    kThread = 2,
+    kFrame = 3,
+    kRecords = 4,
+    kDropped = 5,
+  };
+
+  static constexpr uint32_t kVersion = 1;
+  // How often new records are sent while a consumer is connected. Otherwise
+  // the server thread sleeps.
+  static constexpr int kPollIntervalMs = 10;
+  // Once this much is waiting for the consumer to read it, new records are
+  // dropped instead of sent.
+  static constexpr size_t kMaxPendingBytes = 4 * 1024 * 1024;
+
+  // Returns null if |path| can't be bound.
+  static std::unique_ptr<TraceSocketServer> Create(const Tracer* tracer,
+                                                   const std::string& path);
+
+  ~TraceSocketServer();
+
+  TraceSocketServer(const TraceSocketServer&) = delete;
+  TraceSocketServer& operator=(const TraceSocketServer&) = delete;
+
+ private:
+  // How far into a thread's buffer the consumer has been sent.
+  struct Position {
+    const TraceChunk* chunk = nullptr;
+    uint64_t sequence = 0;
+    size_t index = 0;
+    // The buffer's records() that have been sent or counted as dropped.
+    uint64_t records = 0;
+    bool announced = false;
+  };
+
+  TraceSocketServer(const Tracer* tracer, int listen_fd, std::string path);
+
+  void Run();
+  void Attach(int fd);
+  void Detach();
+
+  // Queues the records committed since the last call, or drops them if too
+  // much is queued already.
+  void SendNewRecords();
+  void SendRecords(const ThreadTraceBuffer& buffer, Position& position);
+  void EncodeRecord(const TraceRecord& record,
+                    const TraceSlot* extra,
+                    uint64_t* last_timestamp);
+
+  // Moves |position| to the end of |buffer|, counting what it skips.
+  void SkipToEnd(const ThreadTraceBuffer& buffer, Position& position);
+
+  void AppendMessage(MessageType type, std::string_view body);
+
+  // Writes as much of |pending_| as the socket takes. False once the
+  // consumer has gone away.
+  bool Flush();
+
+  const Tracer* const tracer_;
+  const int listen_fd_;
+  const std::string path_;
+  int stop_fds_[2] = {-1, -1};
+  int consumer_fd_ = -1;
+
+  // The rest belong to |thread_|.
+  std::map<const ThreadTraceBuffer*, Position> positions_;
+  std::vector<bool> sent_frames_;
+  std::string pending_;
+  size_t pending_offset_ = 0;
+  std::string body_;
+  std::vector<TraceSlot> scratch_;
+  uint64_t dropped_ = 0;
+
+  std::thread thread_;
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_TRACING_TRACE_SOCKET_H_
@@ -0,0 +1,403 @@
+#include "base/tracing/trace_socket.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "base/tracing/trace.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+std::string g_socket_path;
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  base::Tracer* tracer = base::Tracer::Get();
+  tracer->SetEnabledCategories("socket_test");
+  g_socket_path = "/tmp/trace_socket_test." + std::to_string(getpid());
+  if (!tracer->ServeOnSocket(g_socket_path))
+    return 1;
+  return RUN_ALL_TESTS();
+}
+
+namespace base {
+namespace internal {
+namespace {
+
+// Reads the primitives of trace_socket.h's framing. Reading past the end
+// yields zeros and clears ok().
+class Reader {
+ public:
+  explicit Reader(std::string_view data) : data_(data) {}
+
+  bool ok() const { return ok_; }
+  bool done() const { return data_.empty(); }
+
+  uint64_t VarInt() {
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64 && !done(); shift += 7) {
+      uint8_t byte = static_cast<uint8_t>(data_[0]);
+      data_.remove_prefix(1);
+      value |= uint64_t{byte & 0x7fu} << shift;
+      if (!(byte & 0x80))
+        return value;
+    }
+    ok_ = false;
+    return 0;
+  }
+
+  int64_t SignedVarInt() {
+    uint64_t value = VarInt();
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+  }
+
+  std::string_view Bytes(size_t length) {
+    if (length > data_.size()) {
+      ok_ = false;
+      return {};
+    }
+    std::string_view value = data_.substr(0, length);
+    data_.remove_prefix(length);
+    return value;
+  }
+
+  std::string_view String() { return Bytes(VarInt()); }
+
+  double Double() {
+    std::string_view bytes = Bytes(8);
+    uint64_t bits = 0;
+    for (size_t i = 0; i < bytes.size(); i++)
+      bits |= uint64_t{static_cast<uint8_t>(bytes[i])} << (8 * i);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+ private:
+  std::string_view data_;
+  bool ok_ = true;
+};
+
+struct Message {
+  uint8_t type = 0;
+  std::string body;
+};
+
+// A consumer connected to the test's socket.
+class Client {
+ public:
+  Client() {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, g_socket_path.data(), g_socket_path.size());
+    fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ >= 0 && connect(fd_, reinterpret_cast<struct sockaddr*>(&address),
+                            sizeof(address)) != 0) {
+      close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  ~Client() {
+    if (fd_ >= 0)
+      close(fd_);
+  }
+
+  Client(const Client&) = delete;
+  Client& operator=(const Client&) = delete;
+
+  bool connected() const { return fd_ >= 0; }
+
+  // False if no whole message arrives within a few seconds.
+  bool Read(Message* message) {
+    while (true) {
+      Reader header(buffer_);
+      std::string_view type = header.Bytes(1);
+      uint64_t length = header.VarInt();
+      std::string_view body = header.Bytes(length);
+      if (header.ok()) {
+        message->type = static_cast<uint8_t>(type[0]);
+        message->body = std::string(body);
+        buffer_.erase(0, body.data() + body.size() - buffer_.data());
+        return true;
+      }
+      struct pollfd fds = {fd_, POLLIN, 0};
+      if (poll(&fds, 1, 5000) <= 0)
+        return false;
+      char data[64 * 1024];
+      ssize_t result = read(fd_, data, sizeof(data));
+      if (result <= 0)
+        return false;
+      buffer_.append(data, result);
+    }
+  }
+
+  // Reads up to and including the first message of |type|, returning false
+  // if none comes.
+  bool ReadUntil(uint8_t type, std::vector<Message>* messages) {
+    Message message;
+    while (Read(&message)) {
+      messages->push_back(message);
+      if (message.type == type)
+        return true;
+    }
+    return false;
+  }
+
+ private:
+  int fd_ = -1;
+  std::string buffer_;
+};
+
+// Connects and waits for the server to take the connection, after which
+// every record made is sent.
+void Attach(Client& client) {
+  ASSERT_TRUE(client.connected());
+  std::vector<Message> messages;
+  ASSERT_TRUE(client.ReadUntil(TraceSocketServer::kHello, &messages));
+  ASSERT_EQ(messages.size(), 1u);
+}
+
+struct Arg {
+  std::string key;
+  uint64_t type;
+  std::string value;
+};
+
+struct Record {
+  uint64_t tid;
+  uint64_t type;
+  uint64_t frame;
+  uint64_t timestamp;
+  uint64_t payload = 0;
+  std::vector<Arg> args;
+};
+
+std::vector<Record> ParseRecords(std::string_view body) {
+  std::vector<Record> records;
+  Reader in(body);
+  uint64_t tid = in.VarInt();
+  uint64_t timestamp = 0;
+  while (in.ok() && !in.done()) {
+    Record record = {};
+    record.tid = tid;
+    record.type = in.VarInt();
+    record.frame = in.VarInt();
+    timestamp += in.SignedVarInt();
+    record.timestamp = timestamp;
+    if (record.type >= TraceRecord::kCounter) {
+      record.payload = in.VarInt();
+    } else {
+      for (uint64_t count = in.VarInt(); count && in.ok(); count--) {
+        Arg arg;
+        arg.key = std::string(in.String());
+        arg.type = in.VarInt();
+        switch (arg.type) {
+          case TraceArg::kInt:
+            arg.value = std::to_string(in.SignedVarInt());
+            break;
+          case TraceArg::kUint:
+          case TraceArg::kBool:
+            arg.value = std::to_string(in.VarInt());
+            break;
+          case TraceArg::kDouble:
+            arg.value = std::to_string(in.Double());
+            break;
+          case TraceArg::kString:
+          case TraceArg::kCopiedString:
+            arg.value = std::string(in.String());
+            break;
+        }
+        record.args.push_back(arg);
+      }
+    }
+    records.push_back(record);
+  }
+  EXPECT_TRUE(in.ok());
+  return records;
+}
+
+// The frame a kFrame message in |messages| gives |name|, or -1.
+int64_t FindFrame(const std::vector<Message>& messages,
+                  std::string_view name) {
+  for (const Message& message : messages) {
+    if (message.type != TraceSocketServer::kFrame)
+      continue;
+    Reader in(message.body);
+    uint64_t frame = in.VarInt();
+    EXPECT_EQ(in.String(), "socket_test");
+    if (in.String() == name)
+      return static_cast<int64_t>(frame);
+  }
+  return -1;
+}
+
+// Reads until a |type| record of |frame_name| arrives, returning every
+// message read.
+std::vector<Message> ReadUntilRecordOf(Client& client,
+                                       std::string_view frame_name,
+                                       uint64_t type) {
+  std::vector<Message> messages;
+  while (client.ReadUntil(TraceSocketServer::kRecords, &messages)) {
+    int64_t frame = FindFrame(messages, frame_name);
+    if (frame < 0)
+      continue;
+    for (const Record& record : ParseRecords(messages.back().body)) {
+      if (static_cast<int64_t>(record.frame) == frame && record.type == type)
+        return messages;
+    }
+  }
+  ADD_FAILURE() << "no record of " << frame_name;
+  return messages;
+}
+
+std::vector<Record> RecordsIn(const std::vector<Message>& messages) {
+  std::vector<Record> records;
+  for (const Message& message : messages) {
+    if (message.type != TraceSocketServer::kRecords)
+      continue;
+    for (const Record& record : ParseRecords(message.body))
+      records.push_back(record);
+  }
+  return records;
+}
+
+uint64_t CurrentThreadId() {
+  return static_cast<uint64_t>(syscall(SYS_gettid));
+}
+
+TEST(TraceSocketTest, HelloIdentifiesTheProcess) {
+  Client client;
+  ASSERT_TRUE(client.connected());
+  Message message;
+  ASSERT_TRUE(client.Read(&message));
+  EXPECT_EQ(message.type, TraceSocketServer::kHello);
+  Reader in(message.body);
+  EXPECT_EQ(in.Bytes(4), "btrc");
+  EXPECT_EQ(in.VarInt(), TraceSocketServer::kVersion);
+  EXPECT_EQ(in.VarInt(), static_cast<uint64_t>(getpid()));
+  EXPECT_TRUE(in.ok());
+  EXPECT_TRUE(in.done());
+}
+
+TEST(TraceSocketTest, StreamsEventsWithTheirArguments) {
+  Client client;
+  Attach(client);
+  std::string copied = "copied";
+  {
+    TRACE_EVENT("socket_test", "SocketOuter", "count", -3, "ratio", 0.5, "ok",
+                true, "kind", TRACE_STR("literal"), "text", copied);
+    TRACE_EVENT("socket_test", "SocketInner");
+  }
+  std::vector<Message> messages =
+      ReadUntilRecordOf(client, "SocketOuter", TraceRecord::kEnd);
+  int64_t outer = FindFrame(messages, "SocketOuter");
+  int64_t inner = FindFrame(messages, "SocketInner");
+  ASSERT_GE(outer, 0);
+  ASSERT_GE(inner, 0);
+
+  // The thread and its frames are announced before its records.
+  ASSERT_FALSE(messages.empty());
+  EXPECT_EQ(messages[0].type, TraceSocketServer::kThread);
+  Reader thread(messages[0].body);
+  EXPECT_EQ(thread.VarInt(), CurrentThreadId());
+
+  std::vector<Record> records = RecordsIn(messages);
+  ASSERT_EQ(records.size(), 4u);
+  EXPECT_EQ(records[0].tid, CurrentThreadId());
+  EXPECT_EQ(records[0].type, TraceRecord::kBegin);
+  EXPECT_EQ(records[0].frame, static_cast<uint64_t>(outer));
+  EXPECT_EQ(records[1].type, TraceRecord::kBegin);
+  EXPECT_EQ(records[1].frame, static_cast<uint64_t>(inner));
+  EXPECT_EQ(records[2].type, TraceRecord::kEnd);
+  EXPECT_EQ(records[2].frame, static_cast<uint64_t>(inner));
+  EXPECT_EQ(records[3].type, TraceRecord::kEnd);
+  EXPECT_EQ(records[3].frame, static_cast<uint64_t>(outer));
+  for (size_t i = 1; i < records.size(); i++)
+    EXPECT_LE(records[i - 1].timestamp, records[i].timestamp);
+
+  const std::vector<Arg>& args = records[0].args;
+  ASSERT_EQ(args.size(), 5u);
+  EXPECT_EQ(args[0].key, "count");
+  EXPECT_EQ(args[0].type, TraceArg::kInt);
+  EXPECT_EQ(args[0].value, "-3");
+  EXPECT_EQ(args[1].key, "ratio");
+  EXPECT_EQ(args[1].type, TraceArg::kDouble);
+  EXPECT_EQ(args[1].value, std::to_string(0.5));
+  EXPECT_EQ(args[2].key, "ok");
+  EXPECT_EQ(args[2].type, TraceArg::kBool);
+  EXPECT_EQ(args[2].value, "1");
+  EXPECT_EQ(args[3].key, "kind");
+  EXPECT_EQ(args[3].type, TraceArg::kString);
+  EXPECT_EQ(args[3].value, "literal");
+  EXPECT_EQ(args[4].key, "text");
+  EXPECT_EQ(args[4].type, TraceArg::kCopiedString);
+  EXPECT_EQ(args[4].value, "copied");
+  EXPECT_TRUE(records[1].args.empty());
+}
+
+TEST(TraceSocketTest, StreamsPayloads) {
+  Client client;
+  Attach(client);
+  TRACE_COUNTER("socket_test", "SocketCounter", 42);
+  TRACE_ASYNC_BEGIN("socket_test", "SocketAsync", 0x2a);
+  std::vector<Message> messages =
+      ReadUntilRecordOf(client, "SocketAsync", TraceRecord::kAsyncBegin);
+  int64_t counter = FindFrame(messages, "SocketCounter");
+  int64_t async = FindFrame(messages, "SocketAsync");
+
+  std::vector<Record> records = RecordsIn(messages);
+  ASSERT_EQ(records.size(), 2u);
+  EXPECT_EQ(records[0].type, TraceRecord::kCounter);
+  EXPECT_EQ(records[0].frame, static_cast<uint64_t>(counter));
+  EXPECT_EQ(records[0].payload, 42u);
+  EXPECT_EQ(records[1].type, TraceRecord::kAsyncBegin);
+  EXPECT_EQ(records[1].frame, static_cast<uint64_t>(async));
+  EXPECT_EQ(records[1].payload, 0x2au);
+}
+
+TEST(TraceSocketTest, OnlySendsRecordsMadeAfterConnecting) {
+  TRACE_INSTANT("socket_test", "SocketBefore");
+  Client client;
+  Attach(client);
+  TRACE_INSTANT("socket_test", "SocketAfter");
+  std::vector<Message> messages =
+      ReadUntilRecordOf(client, "SocketAfter", TraceRecord::kInstant);
+  EXPECT_EQ(FindFrame(messages, "SocketBefore"), -1);
+  std::vector<Record> records = RecordsIn(messages);
+  ASSERT_EQ(records.size(), 1u);
+  EXPECT_EQ(records[0].type, TraceRecord::kInstant);
+}
+
+TEST(TraceSocketTest, ConsumersCanReconnect) {
+  for (int i = 0; i < 3; i++) {
+    Client client;
+    Attach(client);
+    // Each connection is told about threads and frames afresh.
+    TRACE_INSTANT("socket_test", "SocketReconnect");
+    std::vector<Message> messages =
+        ReadUntilRecordOf(client, "SocketReconnect", TraceRecord::kInstant);
+    EXPECT_EQ(messages[0].type, TraceSocketServer::kThread);
+    EXPECT_GE(FindFrame(messages, "SocketReconnect"), 0);
+  }
+}
+
+TEST(TraceSocketTest, OneSocketPerTracer) {
+  EXPECT_FALSE(Tracer::Get()->ServeOnSocket(g_socket_path + ".other"));
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace base
@@ -0,0 +1,143 @@
+#include "base/tracing/trace_streamer.h"
+
+#include <map>
+#include <string>
+
+namespace base {
+namespace internal {
+
+TraceStreamer::TraceStreamer(const Tracer* tracer,
+                             std::unique_ptr<std::ofstream> file,
+                             size_t max_chunks)
+    : tracer_(tracer),
+      file_(std::move(file)),
+      writer_(tracer, *file_),
+      max_chunks_(max_chunks) {
+  writer_.WriteHeader();
+  thread_ = std::thread(&TraceStreamer::WriterLoop, this);
+}
+
+TraceStreamer::~TraceStreamer() {
+  if (thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+  }
+  for (const PendingChunk& pending : queue_)
+    delete pending.chunk;
+  for (TraceChunk* chunk : free_)
+    delete chunk;
+}
+
+void TraceStreamer::HandOff(ThreadTraceBuffer* buffer) {
+  std::unique_lock<std::mutex> guard(lock_);
+  TraceChunk* full = buffer->tail_;
+  if (finished_) {
+    dropped_records_ += CountRecordsIn(
+        full->slots, full->committed.load(std::memory_order_relaxed));
+    full->committed.store(0, std::memory_order_relaxed);
+    buffer->size_ = 0;
+    return;
+  }
+
+  TraceChunk* empty = nullptr;
+  if (!free_.empty()) {
+    empty = free_.back();
+    free_.pop_back();
+  } else if (outstanding_ < max_chunks_) {
+    empty = new TraceChunk();
+  } else {
+    dropped_records_ += CountRecordsIn(
+        full->slots, full->committed.load(std::memory_order_relaxed));
+    full->committed.store(0, std::memory_order_relaxed);
+    buffer->size_ = 0;
+    return;
+  }
+
+  // Chunks recorded before streaming started are still linked from |head_|;
+  // they go out ahead of the one that just filled up.
+  TraceChunk* chunk = buffer->head_.load(std::memory_order_relaxed);
+  while (chunk) {
+    TraceChunk* next = chunk->next.load(std::memory_order_relaxed);
+    chunk->next.store(nullptr, std::memory_order_relaxed);
+    queue_.push_back({buffer->thread_id(), chunk});
+    outstanding_++;
+    chunk = next;
+  }
+  buffer->head_.store(empty, std::memory_order_release);
+  buffer->tail_ = empty;
+  buffer->size_ = 0;
+  guard.unlock();
+  wake_.notify_one();
+}
+
+void TraceStreamer::WriterLoop() {
+  std::vector<PendingChunk> batch;
+  std::unique_lock<std::mutex> guard(lock_);
+  while (true) {
+    wake_.wait(guard, [this]() { return stopping_ || !queue_.empty(); });
+    if (queue_.empty() && stopping_)
+      return;
+    batch.swap(queue_);
+    guard.unlock();
+    for (const PendingChunk& pending : batch)
+      WriteChunk(pending);
+    file_->flush();
+    guard.lock();
+    for (const PendingChunk& pending : batch)
+      Recycle(pending.chunk);
+    batch.clear();
+  }
+}
+
+void TraceStreamer::WriteChunk(const PendingChunk& pending) {
+  writer_.WriteRecords(
+      pending.thread_id, pending.chunk->slots,
+      pending.chunk->committed.load(std::memory_order_acquire));
+}
+
+void TraceStreamer::Recycle(TraceChunk* chunk) {
+  outstanding_--;
+  if (free_.size() + outstanding_ >= max_chunks_) {
+    delete chunk;
+    return;
+  }
+  chunk->committed.store(0, std::memory_order_relaxed);
+  free_.push_back(chunk);
+}
+
+void TraceStreamer::Finish(
+    const std::vector<std::unique_ptr<ThreadTraceBuffer>>& buffers) {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    stopping_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+
+  // Holding |lock_| keeps every thread's current chunk in place; records
+  // appended while this runs are either written here or dropped.
+  std::lock_guard<std::mutex> guard(lock_);
+  for (const auto& buffer : buffers) {
+    buffer->ForEachRecord(
+        [this, &buffer](const TraceRecord& record, const TraceSlot* extra) {
+          writer_.WriteRecord(buffer->thread_id(), record, extra);
+        });
+  }
+  for (const auto& buffer : buffers)
+    writer_.WriteThreadName(buffer->thread_id(), buffer->thread_name());
+
+  std::map<std::string, json::JSON> other_data;
+  other_data.insert(
+      {"dropped_records", static_cast<ssize_t>(dropped_records_)});
+  other_data.insert({"tracer_overhead", tracer_->Overhead().ToJson()});
+  writer_.WriteFooter(json::Object(std::move(other_data)));
+  file_->flush();
+  finished_ = true;
+}
+
+}  // namespace internal
+}  // namespace base
@@ -0,0 +1,70 @@
+#ifndef BASE_TRACING_TRACE_STREAMER_H_
+#define BASE_TRACING_TRACE_STREAMER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base/tracing/chrome_trace_writer.h"
+#include "base/tracing/trace.h"
+
+namespace base {
+namespace internal {
+
+// Drains full chunks from recording threads to a file on a background thread.
+// Chunks cycle between the recording threads, a queue of chunks waiting to be
+// written, and a free pool; the queue and pool together never hold more than
+// |max_chunks| chunks.
+class TraceStreamer {
+ public:
+  TraceStreamer(const Tracer* tracer,
+                std::unique_ptr<std::ofstream> file,
+                size_t max_chunks);
+  ~TraceStreamer();
+
+  // Called on |buffer|'s own thread when its current chunk is full. Queues the
+  // buffer's chunks for writing and gives it an empty one. If the writer is so
+  // far behind that no chunk is free, the buffer keeps its chunk, emptied, and
+  // the records in it are counted as dropped.
+  void HandOff(ThreadTraceBuffer* buffer);
+
+  // Stops the writer thread, writes what's left in each of |buffers|, and
+  // completes the file.
+  void Finish(const std::vector<std::unique_ptr<ThreadTraceBuffer>>& buffers);
+
+ private:
+  struct PendingChunk {
+    uint64_t thread_id;
+    TraceChunk* chunk;
+  };
+
+  void WriterLoop();
+  void WriteChunk(const PendingChunk& pending);
+  void Recycle(TraceChunk* chunk);
+
+  const Tracer* const tracer_;
+  std::unique_ptr<std::ofstream> file_;
+  ChromeTraceWriter writer_;
+  const size_t max_chunks_;
+
+  std::mutex lock_;
+  std::condition_variable wake_;
+  std::vector<PendingChunk> queue_;
+  std::vector<TraceChunk*> free_;
+  size_t outstanding_ = 0;
+  uint64_t dropped_records_ = 0;
+  bool stopping_ = false;
+  bool finished_ = false;
+
+  std::thread thread_;
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_TRACING_TRACE_STREAMER_H_
@@ -0,0 +1,20 @@
+#include "base/tracing/tracer_overhead.h"
+
+#include <map>
+#include <string>
+
+namespace base {
+
+json::Object TracerOverhead::ToJson() const {
+  std::map<std::string, json::JSON> values;
+  values.insert({"clock_read_ns", clock_read_ns});
+  values.insert({"record_ns", record_ns});
+  values.insert({"records", static_cast<ssize_t>(records)});
+  values.insert({"recording_ns", static_cast<ssize_t>(recording_ns())});
+  values.insert({"buffer_bytes", static_cast<ssize_t>(buffer_bytes)});
+  values.insert({"exports", static_cast<ssize_t>(exports)});
+  values.insert({"export_ns", static_cast<ssize_t>(export_ns)});
+  return json::Object(std::move(values));
+}
+
+}  // namespace base
@@ -0,0 +1,39 @@
+#ifndef BASE_TRACING_TRACER_OVERHEAD_H_
+#define BASE_TRACING_TRACER_OVERHEAD_H_
+
+#include <cstdint>
+
+#include "base/json/json.h"
+
+namespace base {
+
+// What tracing has cost the process so far. Recording time is estimated from
+// per-record costs measured when the Tracer is created, since timing every
+// record would double its cost.
+struct TracerOverhead {
+  // One TraceClock::Now().
+  double clock_read_ns = 0;
+  // Appending one record without arguments, not counting the clock read.
+  double record_ns = 0;
+  // Records appended on every thread, including those dropped or overwritten.
+  uint64_t records = 0;
+  // Trace chunks currently allocated, in bytes.
+  uint64_t buffer_bytes = 0;
+  // Exports started, and the time spent in them, including any in progress.
+  uint64_t exports = 0;
+  uint64_t export_ns = 0;
+
+  // Estimated time spent in StartEvent(), EndEvent() and the like, along with
+  // reading the clock for each of them.
+  uint64_t recording_ns() const {
+    return static_cast<uint64_t>(records * (clock_read_ns + record_ns));
+  }
+
+  // {"clock_read_ns", "record_ns", "records", "recording_ns", "buffer_bytes",
+  //  "exports", "export_ns"}.
+  json::Object ToJson() const;
+};
+
+}  // namespace base
+
+#endif  // BASE_TRACING_TRACER_OVERHEAD_H_